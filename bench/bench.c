@@ -0,0 +1,540 @@
+#include "../resources/width_intervals.h"
+#include "config.h"
+#include "editor.h"
+#include "file_io.h"
+#include "headless.h"
+#include "input.h"
+#include "opt.h"
+#include "os.h"
+#include "output.h"
+#include "terminal.h"
+#include "unicode.h"
+
+// Rendering benchmarks. Every scenario loads a synthetic file into a fresh
+// editor, replays scripted keys against the headless console and times the
+// frames.
+
+#define BENCH_FILE "nino_bench.c"
+
+#define KEY_DOWN "\x1b[B"
+#define KEY_PAGE_DOWN "\x1b[6~"
+#define KEY_END "\x1b[F"
+#define KEY_SHIFT_DOWN "\x1b[1;2B"
+#define KEY_CTRL_DOWN "\x1b[1;5B"
+#define KEY_NEW_SPLIT "\x1c"
+#define KEY_LEFT_SPLIT "\x1b[1;7D"
+#define PASTE_START "\x1b[200~"
+#define PASTE_END "\x1b[201~"
+#define PASTE_SCENARIO "paste"
+#define WIDTH_SCENARIO "width"
+#define WIDTH_LOOKUPS (1 << 24)
+
+typedef struct Scenario {
+    const char* name;
+    const char* cmd;  // Run before the terminal starts
+    void (*setup)(void);
+    void (*step)(int frame);
+} Scenario;
+
+static int bench_rows = 40;
+static int bench_cols = 120;
+static int paste_mb = 16;
+static bool dump_screen = false;
+
+static void dumpScreen(void) {
+    for (int y = 0; y < bench_rows; y++) {
+        char line[4096];
+        int len = 0;
+        for (int x = 0; x < bench_cols && len < (int)sizeof(line) - 4; x++) {
+            uint32_t c = headlessGetCell(y, x);
+            if (c == 0)
+                continue;
+            len += encodeUTF8(c, &line[len]);
+        }
+        while (len > 0 && line[len - 1] == ' ') {
+            len--;
+        }
+        fprintf(stderr, "%.*s\n", len, line);
+    }
+}
+
+static void pushRepeat(const char* keys, int count) {
+    for (int i = 0; i < count; i++) {
+        headlessPushStr(keys);
+    }
+}
+
+static void setupMiddle(void) {
+    pushRepeat(KEY_PAGE_DOWN, 20);
+}
+
+static void setupTyping(void) {
+    setupMiddle();
+    headlessPushStr(KEY_END);
+}
+
+// Both splits show the same lines
+static void setupSplit(void) {
+    headlessPushStr(KEY_NEW_SPLIT);
+    setupTyping();
+    headlessPushStr(KEY_LEFT_SPLIT);
+    setupTyping();
+}
+
+static void stepScroll(int frame) {
+    UNUSED(frame);
+    headlessPushStr(KEY_CTRL_DOWN);
+}
+
+static void stepPage(int frame) {
+    UNUSED(frame);
+    headlessPushStr(KEY_PAGE_DOWN);
+}
+
+static void stepCursor(int frame) {
+    UNUSED(frame);
+    headlessPushStr(KEY_DOWN);
+}
+
+static void stepTyping(int frame) {
+    static const char text[] = " value = compute(index, 42);\r";
+    char c = text[frame % (sizeof(text) - 1)];
+    headlessPushInput(&c, 1);
+}
+
+static void stepSelect(int frame) {
+    UNUSED(frame);
+    headlessPushStr(KEY_SHIFT_DOWN);
+}
+
+static const Scenario scenarios[] = {
+    {"scroll", NULL, NULL, stepScroll},
+    {"page", NULL, NULL, stepPage},
+    {"cursor", NULL, setupMiddle, stepCursor},
+    {"typing", NULL, setupTyping, stepTyping},
+    {"select", NULL, setupMiddle, stepSelect},
+    {"split", NULL, setupSplit, stepTyping},
+    {"wrap", "wrap 1", NULL, stepScroll},
+};
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// C-like source with comments, strings, numbers and the odd long line
+static bool writeBenchFile(const char* path, int lines) {
+    FILE* fp = openFile(path, "w");
+    if (!fp)
+        return false;
+
+    int indent = 0;
+    for (int i = 0; i < lines; i++) {
+        uint32_t r = rng();
+        if (indent == 0) {
+            if (r % 4 == 0) {
+                fprintf(fp, "\n");
+            } else if (r % 4 == 1) {
+                fprintf(fp, "/* Block comment %u\n * spanning lines */\n",
+                        r >> 8);
+                i++;
+            } else {
+                fprintf(fp, "static int func_%d(int a, const char* s) {\n", i);
+                indent = 1;
+            }
+            continue;
+        }
+
+        fprintf(fp, "%*s", indent * 4, "");
+        switch (r % 8) {
+            case 0:
+                fprintf(fp, "// Comment about line %d\n", i);
+                break;
+            case 1:
+                fprintf(fp, "printf(\"value %%d: %%s\\n\", a + %u, s);\n",
+                        r >> 16);
+                break;
+            case 2:
+                fprintf(fp, "if (a > 0x%X && s[%u] != '\\0') {\n", r >> 12,
+                        r % 64);
+                indent++;
+                break;
+            case 3:
+                if (indent > 1) {
+                    fprintf(fp, "}\n");
+                    indent--;
+                } else {
+                    fprintf(fp, "a = a * %u + %u;\n", r % 97, r >> 20);
+                }
+                break;
+            case 4:
+                fprintf(fp, "const char* text = \"");
+                for (int j = 0; j < (int)(r % 40) + 4; j++) {
+                    fprintf(fp, "lorem ipsum dolor sit amet ");
+                }
+                fprintf(fp, "\";\n");
+                break;
+            case 5:
+                fprintf(fp, "\tfor (int k = 0; k < %u; k++) a += k;\n",
+                        r % 1000);
+                break;
+            case 6:
+                if (r % 64 == 6) {
+                    fprintf(fp, "return a;\n}\n");
+                    indent = 0;
+                    i++;
+                    break;
+                }
+                // fall through
+            default:
+                fprintf(fp, "int var_%d = a + %u; /* note */\n", i, r % 1000);
+                break;
+        }
+    }
+    for (; indent > 0; indent--) {
+        fprintf(fp, "}\n");
+    }
+
+    fclose(fp);
+    return true;
+}
+
+static void processPendingInput(void) {
+    while (!headlessInputEmpty()) {
+        editorProcessInput(getTimeMs());
+    }
+}
+
+static bool runScenario(const Scenario* s, const char* path, int frames) {
+    editorInit();
+    gEditor.state = STATE_EDIT;
+    if (s->cmd)
+        editorCmd(s->cmd);
+
+    headlessSetWindowSize(bench_rows, bench_cols);
+    terminalStart();
+
+    EditorFile file;
+    if (editorLoadFile(&file, path, false) != OPEN_FILE ||
+        editorAddFileToActiveSplit(&file) == -1) {
+        terminalExit();
+        editorFree();
+        return false;
+    }
+
+    if (s->setup) {
+        s->setup();
+        processPendingInput();
+        editorRefreshScreen();
+    }
+
+    headlessResetStats();
+    uint64_t input_allocs = 0;
+    int64_t input_us = 0;
+    int64_t render_us = 0;
+    int64_t vt_us = 0;
+    for (int i = 0; i < frames; i++) {
+        s->step(i);
+
+        uint64_t allocs = alloc_count;
+        int64_t frame_start = getTimeUs();
+        editorProcessInput(getTimeMs());
+        int64_t input_end = getTimeUs();
+        input_allocs += alloc_count - allocs;
+
+        int64_t vt_start = headlessGetStats().vt_us;
+        editorRefreshScreen();
+        int64_t frame_vt = headlessGetStats().vt_us - vt_start;
+
+        input_us += input_end - frame_start;
+        render_us += getTimeUs() - input_end - frame_vt;
+        vt_us += frame_vt;
+    }
+
+    HeadlessStats stats = headlessGetStats();
+    double total = (double)(input_us + render_us);
+    printf("%-8s %7d %10.1f %12.1f %10.1f %10.1f %10.1f %9.1f\n", s->name,
+           frames, total > 0 ? frames * 1e6 / total : 0.0,
+           (double)stats.bytes / frames, (double)input_us / frames,
+           (double)render_us / frames, (double)vt_us / frames,
+           (double)input_allocs / frames);
+    fflush(stdout);
+
+    if (dump_screen)
+        dumpScreen();
+
+    terminalExit();
+    editorFree();
+    return true;
+}
+
+// Log-like lines with the odd tab and non-ASCII text
+static void makePasteText(abuf* ab, size_t size) {
+    char line[256];
+    for (int i = 0; ab->len < size; i++) {
+        uint32_t r = rng();
+        const char* note =
+            r % 13 == 0 ? " \xe2\x80\x94 retried \xe2\x9c\x93" : "";
+        int len = snprintf(line, sizeof(line),
+                           "2024-01-%02u 12:%02u:%02u [%s] worker %u:\t"
+                           "request %d took %u ms%s\n",
+                           r % 28 + 1, (r >> 5) % 60, (r >> 11) % 60,
+                           r % 7 == 0 ? "WARN" : "INFO", (r >> 17) % 16, i,
+                           r % 1000, note);
+        abufAppendN(ab, line, len);
+    }
+}
+
+// Times reading a bracketed paste and inserting it in the middle of a file
+static bool runPaste(const char* path) {
+    editorInit();
+    gEditor.state = STATE_EDIT;
+
+    headlessSetWindowSize(bench_rows, bench_cols);
+    terminalStart();
+
+    EditorFile file;
+    if (editorLoadFile(&file, path, false) != OPEN_FILE ||
+        editorAddFileToActiveSplit(&file) == -1) {
+        terminalExit();
+        editorFree();
+        return false;
+    }
+
+    setupTyping();
+    processPendingInput();
+
+    abuf text = ABUF_INIT;
+    makePasteText(&text, (size_t)paste_mb * 1024 * 1024);
+    headlessPushStr(PASTE_START);
+    headlessPushInput(text.buf, text.len);
+    headlessPushStr(PASTE_END);
+
+    int64_t read_start = getTimeUs();
+    EditorInput input = editorReadKey();
+    int64_t read_us = getTimeUs() - read_start;
+
+    bool result = input.type == PASTE_INPUT;
+    size_t lines = input.data.paste.size;
+    int64_t insert_us = 0;
+    if (result) {
+        gEditor.pending_input = input;
+        int64_t insert_start = getTimeUs();
+        editorProcessKeypress();
+        insert_us = getTimeUs() - insert_start;
+        editorRefreshScreen();
+    }
+
+    double mb = text.len / (1024.0 * 1024.0);
+    printf("%-8s %.1f MB, %zu lines, read %.1f MB/s, insert %.1f MB/s\n",
+           PASTE_SCENARIO, mb, lines, read_us > 0 ? mb * 1e6 / read_us : 0.0,
+           insert_us > 0 ? mb * 1e6 / insert_us : 0.0);
+    fflush(stdout);
+
+    if (dump_screen)
+        dumpScreen();
+
+    abufFree(&text);
+    terminalExit();
+    editorFree();
+    return result;
+}
+
+// unicodeWidth before the generated table, binary searching the intervals
+static bool inIntervals(uint32_t ucs, const struct interval* table, int max) {
+    int min = 0;
+    if (ucs < table[0].start || ucs > table[max].end)
+        return false;
+    while (max >= min) {
+        int mid = (min + max) / 2;
+        if (ucs > table[mid].end)
+            min = mid + 1;
+        else if (ucs < table[mid].start)
+            max = mid - 1;
+        else
+            return true;
+    }
+    return false;
+}
+
+static int intervalWidth(uint32_t ucs) {
+    if (ucs == 0)
+        return 0;
+
+    if (ucs < 32 || (ucs >= 0x7F && ucs < 0xA0))
+        return -1;
+
+    if (inIntervals(ucs, double_width,
+                    sizeof(double_width) / sizeof(double_width[0]) - 1))
+        return 2;
+    if (inIntervals(ucs, zero_width,
+                    sizeof(zero_width) / sizeof(zero_width[0]) - 1))
+        return 0;
+    return 1;
+}
+
+typedef struct WidthRange {
+    const char* name;
+    uint32_t start;
+    uint32_t end;
+} WidthRange;
+
+static const WidthRange width_ranges[] = {
+    {"ascii", 0x20, 0x7F},
+    {"latin", 0xA0, 0x250},
+    {"combining", 0x300, 0x370},
+    {"cjk", 0x4E00, 0xA000},
+    {"emoji", 0x1F300, 0x1FB00},
+};
+
+// Nanoseconds per lookup, cycling through the range
+static double timeWidth(int (*width)(uint32_t), const WidthRange* range) {
+    volatile int sink = 0;
+    uint32_t ucs = range->start;
+    int64_t start = getTimeUs();
+    for (int i = 0; i < WIDTH_LOOKUPS; i++) {
+        sink += width(ucs);
+        if (++ucs == range->end)
+            ucs = range->start;
+    }
+    return (getTimeUs() - start) * 1e3 / WIDTH_LOOKUPS;
+}
+
+// Times unicodeWidth against the interval search it replaced
+static bool runWidth(void) {
+    for (uint32_t ucs = 0; ucs < 0x110000; ucs++) {
+        if (unicodeWidth(ucs) != intervalWidth(ucs)) {
+            fprintf(stderr, "Width mismatch at U+%04X\n", ucs);
+            return false;
+        }
+    }
+
+    size_t count = sizeof(width_ranges) / sizeof(width_ranges[0]);
+    for (size_t i = 0; i < count; i++) {
+        const WidthRange* range = &width_ranges[i];
+        double table_ns = timeWidth(unicodeWidth, range);
+        double search_ns = timeWidth(intervalWidth, range);
+        printf("%-8s %-10s table %.2f ns, search %.2f ns\n", WIDTH_SCENARIO,
+               range->name, table_ns, search_ns);
+    }
+    fflush(stdout);
+    return true;
+}
+
+static void usage(void) {
+    printf("Usage: " EDITOR_NAME "_bench [options] [scenario...]\n");
+    printf("Options:\n");
+    printf("  -l <lines>   Lines in the synthetic file (default: 100000)\n");
+    printf("  -f <frames>  Frames per scenario (default: 500)\n");
+    printf("  -r <rows>    Terminal rows (default: 40)\n");
+    printf("  -c <cols>    Terminal columns (default: 120)\n");
+    printf("  -p <MB>      Size of the paste scenario (default: 16)\n");
+    printf("  -d           Dump the last screen of each scenario to stderr\n");
+    printf("  -h           Print this help message and exit\n");
+    printf("Scenarios:");
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        printf(" %s", scenarios[i].name);
+    }
+    printf(" " PASTE_SCENARIO " " WIDTH_SCENARIO "\n");
+}
+
+int main(int argc, char* argv[]) {
+    int lines = 100000;
+    int frames = 500;
+
+    FOR_OPTS(argc, argv) {
+        case 'l':
+            lines = atoi(OPTARG(argc, argv));
+            break;
+        case 'f':
+            frames = atoi(OPTARG(argc, argv));
+            break;
+        case 'r':
+            bench_rows = atoi(OPTARG(argc, argv));
+            break;
+        case 'c':
+            bench_cols = atoi(OPTARG(argc, argv));
+            break;
+        case 'p':
+            paste_mb = atoi(OPTARG(argc, argv));
+            break;
+        case 'd':
+            dump_screen = true;
+            break;
+        case '?':
+        case 'h':
+            usage();
+            return 0;
+    }
+
+    if (lines < 1 || frames < 1 || bench_rows < 3 || bench_cols < 10 ||
+        paste_mb < 1) {
+        usage();
+        return 1;
+    }
+
+    for (int i = 0; i < argc; i++) {
+        bool found = strcmp(argv[i], PASTE_SCENARIO) == 0 ||
+                     strcmp(argv[i], WIDTH_SCENARIO) == 0;
+        for (size_t j = 0; j < sizeof(scenarios) / sizeof(scenarios[0]); j++) {
+            if (strcmp(argv[i], scenarios[j].name) == 0)
+                found = true;
+        }
+        if (!found) {
+            fprintf(stderr, "Unknown scenario: %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (!writeBenchFile(BENCH_FILE, lines)) {
+        fprintf(stderr, "Failed to write %s\n", BENCH_FILE);
+        return 1;
+    }
+
+    printf("%d lines, %dx%d, %d frames\n", lines, bench_cols, bench_rows,
+           frames);
+    printf("%-8s %7s %10s %12s %10s %10s %10s %9s\n", "scenario", "frames",
+           "fps", "bytes/frame", "input us", "render us", "vt us", "in allocs");
+
+    int result = 0;
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        bool selected = argc == 0;
+        for (int j = 0; j < argc; j++) {
+            if (strcmp(argv[j], scenarios[i].name) == 0)
+                selected = true;
+        }
+        if (!selected)
+            continue;
+
+        if (!runScenario(&scenarios[i], BENCH_FILE, frames)) {
+            fprintf(stderr, "Failed to load %s\n", BENCH_FILE);
+            result = 1;
+            break;
+        }
+    }
+
+    bool run_paste = argc == 0;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], PASTE_SCENARIO) == 0)
+            run_paste = true;
+    }
+    if (result == 0 && run_paste && !runPaste(BENCH_FILE)) {
+        fprintf(stderr, "Failed to paste into %s\n", BENCH_FILE);
+        result = 1;
+    }
+
+    bool run_width = argc == 0;
+    for (int i = 0; i < argc; i++) {
+        if (strcmp(argv[i], WIDTH_SCENARIO) == 0)
+            run_width = true;
+    }
+    if (result == 0 && run_width && !runWidth())
+        result = 1;
+
+    remove(BENCH_FILE);
+    return result;
+}
@@ -0,0 +1,31 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include "os.h"
+
+// Console backend for benchmarks. Output is parsed by an in-memory terminal
+// and input is read from a scripted queue instead of a tty.
+
+typedef struct HeadlessStats {
+    uint64_t bytes;   // Bytes written to the console
+    uint64_t writes;  // writeConsole calls
+    int64_t vt_us;    // Time spent parsing the output
+} HeadlessStats;
+
+void headlessSetWindowSize(int rows, int cols);
+// Resizes the terminal and queues a resize event
+void headlessPushResize(int rows, int cols);
+void headlessPushInput(const char* keys, size_t len);
+#define headlessPushStr(s) headlessPushInput((s), strlen(s))
+bool headlessInputEmpty(void);
+
+HeadlessStats headlessGetStats(void);
+void headlessResetStats(void);
+
+// Code point at a screen cell, 0 for the right half of a wide character
+uint32_t headlessGetCell(int row, int col);
+void headlessGetCursor(int* row, int* col);
+
+void headlessFree(void);
+
+#endif
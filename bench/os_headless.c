@@ -0,0 +1,459 @@
+#include "headless.h"
+
+#include "unicode.h"
+#include "utils.h"
+
+// Console
+
+// Scripted input bytes, resizes are queued by the input offset they come at
+typedef struct HeadlessResize {
+    size_t offset;
+    ConsoleSize size;
+} HeadlessResize;
+
+static abuf input = ABUF_INIT;
+static size_t input_head = 0;
+static VECTOR(HeadlessResize) resizes;
+static uint32_t resize_head = 0;
+
+static HeadlessStats stats;
+
+// Terminal state
+
+#define VT_PARAM_MAX 16
+
+typedef enum VTState {
+    VT_GROUND,
+    VT_ESCAPE,
+    VT_CSI,
+    VT_OSC,
+    VT_OSC_ESCAPE,
+} VTState;
+
+static struct {
+    int rows;
+    int cols;
+    uint32_t* cells;
+
+    int x;
+    int y;
+    int scroll_top;
+    int scroll_bottom;  // Inclusive
+
+    VTState state;
+    int params[VT_PARAM_MAX];
+    int param_count;
+
+    char utf8[4];
+    int utf8_len;
+    int utf8_need;
+} vt = {.rows = 24, .cols = 80, .scroll_bottom = 23};
+
+void osInit(void) {}
+
+void osDeinit(void) {
+    headlessFree();
+}
+
+void enableRawMode(void) {}
+
+void disableRawMode(void) {}
+
+bool isStdinTty(void) {
+    return true;
+}
+
+static void inputReset(void) {
+    if (input_head == input.len && resize_head == resizes.size) {
+        input.len = 0;
+        input_head = 0;
+        vector_clear(resizes);
+        resize_head = 0;
+    }
+}
+
+// Bytes before the next resize
+static size_t inputAvailable(void) {
+    size_t end = input.len;
+    if (resize_head < resizes.size)
+        end = resizes.data[resize_head].offset;
+    return end - input_head;
+}
+
+ConsoleEvent readConsoleEvent(int timeout_ms) {
+    UNUSED(timeout_ms);
+
+    ConsoleEvent ev = {.type = CONSOLE_EVENT_NONE};
+    if (resize_head < resizes.size &&
+        resizes.data[resize_head].offset == input_head) {
+        ev.type = CONSOLE_EVENT_RESIZE;
+        ev.data.resize = resizes.data[resize_head++].size;
+    } else if (input_head < input.len) {
+        size_t byte_size;
+        ev.type = CONSOLE_EVENT_KEY;
+        ev.data.unicode = decodeUTF8(&input.buf[input_head],
+                                     inputAvailable(), &byte_size);
+        input_head += byte_size ? byte_size : 1;
+    }
+    inputReset();
+    return ev;
+}
+
+bool isConsoleInputPending(int timeout_ms) {
+    UNUSED(timeout_ms);
+    return !headlessInputEmpty();
+}
+
+size_t peekConsoleInput(const char** data, int timeout_ms) {
+    UNUSED(timeout_ms);
+    *data = &input.buf[input_head];
+    return inputAvailable();
+}
+
+void consumeConsoleInput(size_t count) {
+    input_head += count;
+    inputReset();
+}
+
+static void vtClear(int row, int start, int end) {
+    if (start < 0)
+        start = 0;
+    if (end > vt.cols)
+        end = vt.cols;
+    for (int i = start; i < end; i++) {
+        vt.cells[row * vt.cols + i] = ' ';
+    }
+}
+
+// Scroll lines [top, bottom] up by n, negative n scrolls down
+static void vtScroll(int top, int bottom, int n) {
+    int height = bottom - top + 1;
+    if (height <= 0 || n == 0)
+        return;
+
+    int count = n > 0 ? n : -n;
+    if (count > height)
+        count = height;
+
+    size_t row_size = sizeof(uint32_t) * vt.cols;
+    uint32_t* base = &vt.cells[top * vt.cols];
+    if (n > 0) {
+        memmove(base, base + count * vt.cols, row_size * (height - count));
+        for (int i = bottom - count + 1; i <= bottom; i++) {
+            vtClear(i, 0, vt.cols);
+        }
+    } else {
+        memmove(base + count * vt.cols, base, row_size * (height - count));
+        for (int i = top; i < top + count; i++) {
+            vtClear(i, 0, vt.cols);
+        }
+    }
+}
+
+static void vtLineFeed(void) {
+    if (vt.y == vt.scroll_bottom) {
+        vtScroll(vt.scroll_top, vt.scroll_bottom, 1);
+    } else if (vt.y < vt.rows - 1) {
+        vt.y++;
+    }
+}
+
+static void vtPutChar(uint32_t c) {
+    int width = unicodeWidth(c);
+    if (width < 0)
+        return;
+
+    if (width == 0) {
+        // Combining characters stay with the previous cell
+        return;
+    }
+
+    if (vt.x + width > vt.cols) {
+        vt.x = 0;
+        vtLineFeed();
+    }
+
+    uint32_t* cell = &vt.cells[vt.y * vt.cols + vt.x];
+    cell[0] = c;
+    if (width == 2)
+        cell[1] = 0;
+    vt.x += width;
+}
+
+static int vtParam(int index, int default_value) {
+    if (index >= vt.param_count || vt.params[index] == 0)
+        return default_value;
+    return vt.params[index];
+}
+
+static int clamp(int x, int min, int max) {
+    if (x < min)
+        return min;
+    if (x > max)
+        return max;
+    return x;
+}
+
+static void vtCSI(char final) {
+    int n = vtParam(0, 1);
+    switch (final) {
+        case 'H':
+        case 'f':
+            vt.y = clamp(vtParam(0, 1) - 1, 0, vt.rows - 1);
+            vt.x = clamp(vtParam(1, 1) - 1, 0, vt.cols - 1);
+            break;
+
+        case 'A':
+            vt.y = clamp(vt.y - n, 0, vt.rows - 1);
+            break;
+        case 'B':
+            vt.y = clamp(vt.y + n, 0, vt.rows - 1);
+            break;
+        case 'C':
+            vt.x = clamp(vt.x + n, 0, vt.cols - 1);
+            break;
+        case 'D':
+            vt.x = clamp(vt.x - n, 0, vt.cols - 1);
+            break;
+
+        case 'K': {
+            int mode = vtParam(0, 0);
+            if (mode == 0)
+                vtClear(vt.y, vt.x, vt.cols);
+            else if (mode == 1)
+                vtClear(vt.y, 0, vt.x + 1);
+            else
+                vtClear(vt.y, 0, vt.cols);
+        } break;
+
+        case 'J':
+            for (int i = 0; i < vt.rows; i++) {
+                vtClear(i, 0, vt.cols);
+            }
+            break;
+
+        case 'X':
+            vtClear(vt.y, vt.x, vt.x + n);
+            break;
+
+        case 'r':
+            vt.scroll_top = clamp(vtParam(0, 1) - 1, 0, vt.rows - 1);
+            vt.scroll_bottom = clamp(vtParam(1, vt.rows) - 1, 0, vt.rows - 1);
+            if (vt.scroll_top >= vt.scroll_bottom) {
+                vt.scroll_top = 0;
+                vt.scroll_bottom = vt.rows - 1;
+            }
+            vt.x = 0;
+            vt.y = 0;
+            break;
+
+        case 'S':
+            vtScroll(vt.scroll_top, vt.scroll_bottom, n);
+            break;
+        case 'T':
+            vtScroll(vt.scroll_top, vt.scroll_bottom, -n);
+            break;
+
+        case 'L':
+            if (vt.y >= vt.scroll_top && vt.y <= vt.scroll_bottom)
+                vtScroll(vt.y, vt.scroll_bottom, -n);
+            break;
+        case 'M':
+            if (vt.y >= vt.scroll_top && vt.y <= vt.scroll_bottom)
+                vtScroll(vt.y, vt.scroll_bottom, n);
+            break;
+
+        default:
+            // SGR, modes and queries don't change the text
+            break;
+    }
+}
+
+static void vtFeed(uint8_t c) {
+    switch (vt.state) {
+        case VT_GROUND:
+            break;
+
+        case VT_ESCAPE:
+            if (c == '[') {
+                vt.state = VT_CSI;
+                vt.param_count = 0;
+                memset(vt.params, 0, sizeof(vt.params));
+            } else if (c == ']') {
+                vt.state = VT_OSC;
+            } else {
+                vt.state = VT_GROUND;
+            }
+            return;
+
+        case VT_CSI:
+            if (c >= '0' && c <= '9') {
+                if (vt.param_count == 0)
+                    vt.param_count = 1;
+                int* p = &vt.params[vt.param_count - 1];
+                *p = *p * 10 + (c - '0');
+            } else if (c == ';') {
+                if (vt.param_count == 0)
+                    vt.param_count = 1;
+                if (vt.param_count < VT_PARAM_MAX)
+                    vt.param_count++;
+            } else if (c >= 0x40 && c <= 0x7E) {
+                vtCSI((char)c);
+                vt.state = VT_GROUND;
+            }
+            // Private markers and intermediates are ignored
+            return;
+
+        case VT_OSC:
+            if (c == '\a')
+                vt.state = VT_GROUND;
+            else if (c == '\x1b')
+                vt.state = VT_OSC_ESCAPE;
+            return;
+
+        case VT_OSC_ESCAPE:
+            vt.state = c == '\\' ? VT_GROUND : VT_OSC;
+            return;
+    }
+
+    if (vt.utf8_need) {
+        if ((c & 0xC0) == 0x80) {
+            vt.utf8[vt.utf8_len++] = (char)c;
+            if (vt.utf8_len == vt.utf8_need) {
+                size_t byte_size;
+                vtPutChar(decodeUTF8(vt.utf8, vt.utf8_len, &byte_size));
+                vt.utf8_need = 0;
+            }
+            return;
+        }
+        vt.utf8_need = 0;
+    }
+
+    if (c >= 0x80) {
+        int need = 0;
+        if ((c & 0xE0) == 0xC0)
+            need = 2;
+        else if ((c & 0xF0) == 0xE0)
+            need = 3;
+        else if ((c & 0xF8) == 0xF0)
+            need = 4;
+
+        if (need) {
+            vt.utf8[0] = (char)c;
+            vt.utf8_len = 1;
+            vt.utf8_need = need;
+        }
+        return;
+    }
+
+    switch (c) {
+        case '\x1b':
+            vt.state = VT_ESCAPE;
+            break;
+        case '\r':
+            vt.x = 0;
+            break;
+        case '\n':
+            vtLineFeed();
+            break;
+        case '\b':
+            if (vt.x > 0)
+                vt.x--;
+            break;
+        default:
+            if (c >= 0x20 && c != 0x7F)
+                vtPutChar(c);
+            break;
+    }
+}
+
+static void vtResize(int rows, int cols) {
+    free(vt.cells);
+    vt.rows = rows;
+    vt.cols = cols;
+    vt.cells = malloc_s(sizeof(uint32_t) * rows * cols);
+    for (int i = 0; i < rows; i++) {
+        vtClear(i, 0, cols);
+    }
+    vt.x = 0;
+    vt.y = 0;
+    vt.scroll_top = 0;
+    vt.scroll_bottom = rows - 1;
+}
+
+int writeConsole(const void* buf, size_t count) {
+    if (!vt.cells)
+        vtResize(vt.rows, vt.cols);
+
+    int64_t start = getTimeUs();
+    const uint8_t* p = buf;
+    for (size_t i = 0; i < count; i++) {
+        vtFeed(p[i]);
+    }
+    stats.vt_us += getTimeUs() - start;
+    stats.bytes += count;
+    stats.writes++;
+    return (int)count;
+}
+
+int getWindowSize(int* rows, int* cols) {
+    *rows = vt.rows;
+    *cols = vt.cols;
+    return 0;
+}
+
+void osSuspend(void) {}
+
+void osRunShell(const char* shell_hint, const char* cmd) {
+    UNUSED(shell_hint);
+    UNUSED(cmd);
+}
+
+void headlessSetWindowSize(int rows, int cols) {
+    vtResize(rows, cols);
+}
+
+void headlessPushResize(int rows, int cols) {
+    vtResize(rows, cols);
+    HeadlessResize resize = {
+        .offset = input.len,
+        .size = {.rows = rows, .cols = cols},
+    };
+    vector_push(resizes, resize);
+}
+
+void headlessPushInput(const char* keys, size_t len) {
+    abufAppendN(&input, keys, len);
+}
+
+bool headlessInputEmpty(void) {
+    return input_head == input.len && resize_head == resizes.size;
+}
+
+HeadlessStats headlessGetStats(void) {
+    return stats;
+}
+
+void headlessResetStats(void) {
+    memset(&stats, 0, sizeof(stats));
+}
+
+uint32_t headlessGetCell(int row, int col) {
+    if (!vt.cells || row < 0 || row >= vt.rows || col < 0 || col >= vt.cols)
+        return ' ';
+    return vt.cells[row * vt.cols + col];
+}
+
+void headlessGetCursor(int* row, int* col) {
+    *row = vt.y;
+    *col = vt.x;
+}
+
+void headlessFree(void) {
+    free(vt.cells);
+    vt.cells = NULL;
+    abufFree(&input);
+    input_head = 0;
+    vector_free(resizes);
+    resize_head = 0;
+}
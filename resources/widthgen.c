@@ -0,0 +1,126 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "width_intervals.h"
+
+// Generates a two-stage table for unicodeWidth.
+// Code points are split into blocks, identical blocks are stored once and
+// an index maps each block number to its data. Every code point takes
+// 2 bits holding width + 1.
+
+#define CODE_POINT_MAX 0x110000
+#define BLOCK_SHIFT 8
+#define BLOCK_SIZE (1 << BLOCK_SHIFT)
+#define BLOCK_COUNT (CODE_POINT_MAX / BLOCK_SIZE)
+#define BLOCK_BYTES (BLOCK_SIZE / 4)
+#define MAX_UNIQUE_BLOCKS 256
+
+static bool inTable(uint32_t ucs, const struct interval* table, int max) {
+    int min = 0;
+    if (ucs < table[0].start || ucs > table[max].end)
+        return false;
+    while (max >= min) {
+        int mid = (min + max) / 2;
+        if (ucs > table[mid].end)
+            min = mid + 1;
+        else if (ucs < table[mid].start)
+            max = mid - 1;
+        else
+            return true;
+    }
+    return false;
+}
+
+static int width(uint32_t ucs) {
+    if (ucs == 0)
+        return 0;
+
+    if (ucs < 32 || (ucs >= 0x7F && ucs < 0xA0))
+        return -1;
+
+    if (inTable(ucs, double_width,
+                sizeof(double_width) / sizeof(double_width[0]) - 1))
+        return 2;
+    if (inTable(ucs, zero_width,
+                sizeof(zero_width) / sizeof(zero_width[0]) - 1))
+        return 0;
+    return 1;
+}
+
+static uint8_t blocks[MAX_UNIQUE_BLOCKS][BLOCK_BYTES];
+static uint8_t block_index[BLOCK_COUNT];
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <output file>\n", argv[0]);
+        return 1;
+    }
+
+    int block_count = 0;
+    for (int b = 0; b < BLOCK_COUNT; b++) {
+        uint8_t block[BLOCK_BYTES] = {0};
+        for (int i = 0; i < BLOCK_SIZE; i++) {
+            uint32_t ucs = (uint32_t)b * BLOCK_SIZE + i;
+            block[i / 4] |= (uint8_t)((width(ucs) + 1) << ((i % 4) * 2));
+        }
+
+        int found = -1;
+        for (int i = 0; i < block_count; i++) {
+            if (memcmp(blocks[i], block, BLOCK_BYTES) == 0) {
+                found = i;
+                break;
+            }
+        }
+
+        if (found < 0) {
+            if (block_count == MAX_UNIQUE_BLOCKS) {
+                fprintf(stderr, "Too many unique blocks.\n");
+                return 1;
+            }
+            memcpy(blocks[block_count], block, BLOCK_BYTES);
+            found = block_count++;
+        }
+        block_index[b] = (uint8_t)found;
+    }
+
+    FILE* out = fopen(argv[1], "w");
+    if (!out) {
+        fprintf(stderr, "Failed to open %s to write.\n", argv[1]);
+        return 1;
+    }
+
+    fprintf(out, "#ifndef WIDTH_TABLE_H\n");
+    fprintf(out, "#define WIDTH_TABLE_H\n\n");
+
+    fprintf(out, "#define WIDTH_TABLE_MAX 0x%X\n", CODE_POINT_MAX);
+    fprintf(out, "#define WIDTH_BLOCK_SHIFT %d\n", BLOCK_SHIFT);
+    fprintf(out, "#define WIDTH_BLOCK_MASK 0x%X\n\n", BLOCK_SIZE - 1);
+
+    fprintf(out, "static const uint8_t width_index[%d] = {", BLOCK_COUNT);
+    for (int i = 0; i < BLOCK_COUNT; i++) {
+        if (i % 16 == 0)
+            fprintf(out, "\n   ");
+        fprintf(out, " %d,", block_index[i]);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "static const uint8_t width_blocks[%d][%d] = {\n", block_count,
+            BLOCK_BYTES);
+    for (int b = 0; b < block_count; b++) {
+        fprintf(out, "    {");
+        for (int i = 0; i < BLOCK_BYTES; i++) {
+            if (i % 16 == 0)
+                fprintf(out, "\n       ");
+            fprintf(out, " 0x%02X,", blocks[b][i]);
+        }
+        fprintf(out, "\n    },\n");
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "#endif\n");
+
+    fclose(out);
+    return 0;
+}
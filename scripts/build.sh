@@ -7,6 +7,7 @@ set -eu
 : "${HOST_CC:=cc}"
 : "${CC:=cc}"
 : "${CFLAGS:=-std=c11 -Wall -Wextra -pedantic}"
+: "${LIBS:=-pthread}"
 
 # Add command line arguments to CFLAGS
 for arg in "$@"; do
@@ -24,10 +25,11 @@ BUILD_DIR="$PROJECT_ROOT/build"
 
 mkdir -p "$BUILD_DIR"
 
-printf '%s\n' "[1/3] Building bundler..."
+printf '%s\n' "[1/4] Building generators..."
 "$HOST_CC" $CFLAGS "$RESOURCE_DIR/bundler.c" -o "$BUILD_DIR/bundler"
+"$HOST_CC" $CFLAGS "$RESOURCE_DIR/widthgen.c" -o "$BUILD_DIR/widthgen"
 
-printf '%s\n' "[2/3] Generating bundle.h..."
+printf '%s\n' "[2/4] Generating bundle.h..."
 SYNTAX_FILES=""
 for f in "$RESOURCE_DIR"/syntax/*.json; do
     [ -f "$f" ] && SYNTAX_FILES="$SYNTAX_FILES $f"
@@ -40,6 +42,9 @@ fi
 
 "$BUILD_DIR/bundler" "$RESOURCE_DIR/bundle.h" $SYNTAX_FILES
 
+printf '%s\n' "[3/4] Generating width_table.h..."
+"$BUILD_DIR/widthgen" "$RESOURCE_DIR/width_table.h"
+
 SOURCES=""
 for f in "$SRC_DIR"/*.c; do
     [ -f "$f" ] || continue
@@ -50,12 +55,13 @@ for f in "$SRC_DIR"/*.c; do
 
 done
 
-printf '%s\n' "[3/3] Building $OUTPUT..."
+printf '%s\n' "[4/4] Building $OUTPUT..."
 $CC $CFLAGS \
     -include "$SRC_DIR/common.h" \
     -DEDITOR_NAME="\"$EDITOR_NAME\"" \
     -DEDITOR_VERSION="\"$EDITOR_VERSION\"" \
     $SOURCES \
+    $LIBS \
     -o "$BUILD_DIR/$OUTPUT"
 
 printf '%s\n' "Done: $BUILD_DIR/$OUTPUT"
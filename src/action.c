@@ -1,6 +1,9 @@
 #include "action.h"
 
+#include "config.h"
 #include "editor.h"
+#include "os.h"
+#include "prompt.h"
 
 static int editorPosCmp(int x1, int y1, int x2, int y2) {
     if (y1 < y2)
@@ -51,21 +54,55 @@ static void editorPosUpdate(int* x,
     }
 }
 
+bool editorEditCanMove(const EditorFile* file, size_t lines) {
+    // Moved texts are only in memory, the journal needs the bytes
+    return !file->undo.journal && lines >= EDIT_MOVE_MIN_LINES;
+}
+
+void editorEditSetBefore(EditorFile* file,
+                         Edit* edit,
+                         EditorSelectRange range) {
+    editorFreeClipboardContent(&edit->before);
+    edit->move_before =
+        editorEditCanMove(file, range.end_y - range.start_y + 1);
+    if (!edit->move_before) {
+        editorCopyText(file, &edit->before, range);
+        return;
+    }
+
+    // Only the shape, the lines are moved in when the edit is applied
+    EditorClipboard* before = &edit->before;
+    before->size = range.end_y - range.start_y + 1;
+    before->lines = calloc_s(before->size, sizeof(Str));
+    before->lines[0].size = file->row[range.start_y].size - range.start_x;
+    for (int i = range.start_y + 1; i < range.end_y; i++) {
+        before->lines[i - range.start_y].size = file->row[i].size;
+    }
+    before->lines[before->size - 1].size = range.end_x;
+}
+
 void editorApplyEdit(EditorTab* tab, Edit* edit, bool undo) {
     EditorFile* file = editorTabGetFile(tab);
 
-    EditorSelectRange delete_range;
-    EditorClipboard* to_add;
-    if (undo) {
-        delete_range = getClipboardRange(edit->x, edit->y, &edit->after);
-        to_add = &edit->before;
+    EditorClipboard* to_remove = undo ? &edit->after : &edit->before;
+    EditorClipboard* to_add = undo ? &edit->before : &edit->after;
+    bool move_remove = undo ? edit->move_after : edit->move_before;
+    bool move_add = undo ? edit->move_before : edit->move_after;
+
+    EditorSelectRange delete_range =
+        getClipboardRange(edit->x, edit->y, to_remove);
+
+    if (move_remove) {
+        editorDetachText(file, to_remove, delete_range);
     } else {
-        delete_range = getClipboardRange(edit->x, edit->y, &edit->before);
-        to_add = &edit->after;
+        editorDeleteText(file, delete_range);
     }
 
-    editorDeleteText(file, delete_range);
-    editorPasteText(file, to_add, edit->x, edit->y);
+    if (move_add) {
+        editorAttachText(file, to_add, edit->x, edit->y);
+    } else {
+        editorPasteText(file, to_add, edit->x, edit->y);
+    }
 
     EditorSelectRange insert_range =
         getClipboardRange(edit->x, edit->y, to_add);
@@ -102,10 +139,509 @@ void editorApplyEdit(EditorTab* tab, Edit* edit, bool undo) {
     }
 }
 
+// Record layout
+#define RECORD_HEADER_SIZE 9  // u64 size, u8 type
+#define RECORD_TRAILER_SIZE 8
+#define CURSOR_SIZE 20
+
+// Edit record fields
+#define EDIT_X_OFFSET RECORD_HEADER_SIZE
+#define EDIT_NEW_CURSOR_OFFSET (EDIT_X_OFFSET + 8 + CURSOR_SIZE)
+#define EDIT_TIME_OFFSET (EDIT_NEW_CURSOR_OFFSET + CURSOR_SIZE)
+#define EDIT_BEFORE_OFFSET (EDIT_TIME_OFFSET + 8)
+
+#define UNDO_LOG_MIN_CAPACITY 4096
+
+static void logReserve(EditorUndoLog* log, size_t size) {
+    if (log->len + size <= log->capacity)
+        return;
+
+    size_t capacity = log->capacity ? log->capacity : UNDO_LOG_MIN_CAPACITY;
+    while (capacity < log->len + size) {
+        capacity *= 2;
+    }
+    log->data = realloc_s(log->data, capacity);
+    log->capacity = capacity;
+}
+
+static void logWrite(EditorUndoLog* log, const void* data, size_t size) {
+    if (size == 0)
+        return;
+    logReserve(log, size);
+    memcpy(&log->data[log->len], data, size);
+    log->len += size;
+}
+
+static void logWriteInt(EditorUndoLog* log, int32_t value) {
+    logWrite(log, &value, sizeof(value));
+}
+
+static void logWriteCursor(EditorUndoLog* log, const EditorCursor* cursor) {
+    logWriteInt(log, cursor->x);
+    logWriteInt(log, cursor->y);
+    logWriteInt(log, cursor->is_selected);
+    logWriteInt(log, cursor->select_x);
+    logWriteInt(log, cursor->select_y);
+}
+
+// A moved clipboard is taken as a block, written as -1 and its index
+static void logWriteClipboard(EditorUndoLog* log,
+                              uint64_t offset,
+                              EditorClipboard* clipboard,
+                              bool move) {
+    if (move) {
+        EditorUndoBlock block = {.offset = offset, .text = *clipboard};
+        memset(clipboard, 0, sizeof(EditorClipboard));
+        logWriteInt(log, -1);
+        logWriteInt(log, (int32_t)log->blocks.size);
+        vector_push(log->blocks, block);
+        return;
+    }
+
+    logWriteInt(log, (int32_t)clipboard->size);
+    for (size_t i = 0; i < clipboard->size; i++) {
+        logWriteInt(log, clipboard->lines[i].size);
+        logWrite(log, clipboard->lines[i].data, clipboard->lines[i].size);
+    }
+}
+
+static void logWriteRecord(EditorUndoLog* log, EditorAction* action) {
+    size_t start = log->len;
+    uint64_t size = 0;  // Filled in at the end
+    logWrite(log, &size, sizeof(size));
+    uint8_t type = action->type;
+    logWrite(log, &type, sizeof(type));
+
+    switch (action->type) {
+        case ACTION_EDIT: {
+            EditAction* edit = &action->edit;
+            uint64_t offset = log->base + start;
+            logWriteInt(log, edit->data.x);
+            logWriteInt(log, edit->data.y);
+            logWriteCursor(log, &edit->old_cursor);
+            logWriteCursor(log, &edit->new_cursor);
+            logWrite(log, &edit->time_ms, sizeof(edit->time_ms));
+            logWriteClipboard(log, offset, &edit->data.before,
+                              edit->data.move_before);
+            logWriteClipboard(log, offset, &edit->data.after,
+                              edit->data.move_after);
+        } break;
+
+        case ACTION_ATTRI: {
+            uint8_t newline[2] = {
+                (uint8_t)action->attri.old_newline,
+                (uint8_t)action->attri.new_newline,
+            };
+            logWrite(log, newline, sizeof(newline));
+        } break;
+    }
+
+    size = log->len - start + RECORD_TRAILER_SIZE;
+    memcpy(&log->data[start], &size, sizeof(size));
+    logWrite(log, &size, sizeof(size));
+}
+
+typedef struct RecordReader {
+    const char* p;
+    const char* end;
+    bool error;
+
+    EditorUndoLog* log;
+    // Blocks of the before and after texts, -1 if none
+    int32_t blocks[2];
+    int block_count;
+} RecordReader;
+
+static void readBytes(RecordReader* r, void* out, size_t size) {
+    if (r->error || (size_t)(r->end - r->p) < size) {
+        r->error = true;
+        memset(out, 0, size);
+        return;
+    }
+    memcpy(out, r->p, size);
+    r->p += size;
+}
+
+static int32_t readInt(RecordReader* r) {
+    int32_t value;
+    readBytes(r, &value, sizeof(value));
+    return value;
+}
+
+static void readCursor(RecordReader* r, EditorCursor* cursor) {
+    cursor->x = readInt(r);
+    cursor->y = readInt(r);
+    cursor->is_selected = readInt(r);
+    cursor->select_x = readInt(r);
+    cursor->select_y = readInt(r);
+}
+
+static void readClipboard(RecordReader* r,
+                          EditorClipboard* clipboard,
+                          bool* move) {
+    int32_t size = readInt(r);
+    int32_t* block = &r->blocks[r->block_count++];
+    *block = -1;
+    if (size == -1) {
+        // Shared with the block until it's given back
+        *block = readInt(r);
+        if (*block < 0 || (uint32_t)*block >= r->log->blocks.size) {
+            r->error = true;
+            *block = -1;
+            return;
+        }
+        *clipboard = r->log->blocks.data[*block].text;
+        *move = true;
+        return;
+    }
+
+    if (size < 0 || size > (r->end - r->p) / 4) {
+        r->error = true;
+        return;
+    }
+    if (size == 0)
+        return;
+
+    clipboard->size = size;
+    clipboard->lines = calloc_s(size, sizeof(Str));
+    for (int32_t i = 0; i < size; i++) {
+        Str* line = &clipboard->lines[i];
+        int32_t len = readInt(r);
+        if (len < 0 || len > r->end - r->p) {
+            r->error = true;
+            return;
+        }
+        if (len > 0) {
+            line->data = malloc_s(len);
+            readBytes(r, line->data, len);
+        }
+        line->size = len;
+    }
+}
+
+static void editorFreeActionContent(EditorAction* action) {
+    if (action->type == ACTION_EDIT) {
+        editorFreeClipboardContent(&action->edit.data.before);
+        editorFreeClipboardContent(&action->edit.data.after);
+    }
+}
+
+// Give the moved texts of a decoded action back to their blocks
+static void logReturnBlocks(EditorUndoLog* log,
+                            EditorAction* action,
+                            const int32_t blocks[2]) {
+    if (action->type != ACTION_EDIT)
+        return;
+
+    EditorClipboard* texts[2] = {
+        &action->edit.data.before,
+        &action->edit.data.after,
+    };
+    for (int i = 0; i < 2; i++) {
+        if (blocks[i] < 0)
+            continue;
+        log->blocks.data[blocks[i]].text = *texts[i];
+        memset(texts[i], 0, sizeof(EditorClipboard));
+    }
+}
+
+static bool decodeRecord(EditorUndoLog* log,
+                         const char* record,
+                         size_t size,
+                         EditorAction* action,
+                         int32_t blocks[2]) {
+    memset(action, 0, sizeof(EditorAction));
+    blocks[0] = blocks[1] = -1;
+    if (size < RECORD_HEADER_SIZE + RECORD_TRAILER_SIZE)
+        return false;
+
+    RecordReader r = {
+        .p = record + RECORD_HEADER_SIZE,
+        .end = record + size - RECORD_TRAILER_SIZE,
+        .log = log,
+        .blocks = {-1, -1},
+    };
+    action->type = (uint8_t)record[RECORD_HEADER_SIZE - 1];
+    switch (action->type) {
+        case ACTION_EDIT: {
+            EditAction* edit = &action->edit;
+            edit->data.x = readInt(&r);
+            edit->data.y = readInt(&r);
+            readCursor(&r, &edit->old_cursor);
+            readCursor(&r, &edit->new_cursor);
+            readBytes(&r, &edit->time_ms, sizeof(edit->time_ms));
+            readClipboard(&r, &edit->data.before, &edit->data.move_before);
+            readClipboard(&r, &edit->data.after, &edit->data.move_after);
+            blocks[0] = r.blocks[0];
+            blocks[1] = r.blocks[1];
+        } break;
+
+        case ACTION_ATTRI: {
+            uint8_t newline[2];
+            readBytes(&r, newline, sizeof(newline));
+            action->attri.old_newline = newline[0];
+            action->attri.new_newline = newline[1];
+        } break;
+
+        default:
+            r.error = true;
+            break;
+    }
+
+    if (r.error) {
+        logReturnBlocks(log, action, r.blocks);
+        editorFreeActionContent(action);
+        return false;
+    }
+    return true;
+}
+
+static bool spillRead(EditorUndoLog* log,
+                      uint64_t offset,
+                      void* out,
+                      size_t size) {
+    if (offset + size <= log->map_end) {
+        memcpy(out, &log->map[log->spill_start + offset], size);
+        return true;
+    }
+    return seekFile(log->spill, log->spill_start + offset) &&
+           fread(out, 1, size, log->spill) == size;
+}
+
+// Read the record that ends at offset when going back, or starts at it.
+// *next is set to the other end of the record.
+static bool logReadRecord(EditorUndoLog* log,
+                          uint64_t offset,
+                          bool back,
+                          EditorAction* action,
+                          int32_t blocks[2],
+                          uint64_t* next) {
+    uint64_t size;
+    // Records are spilled whole, so they are either all in memory or not
+    if (offset > log->base || (!back && offset == log->base)) {
+        size_t pos = offset - log->base;
+        if (back) {
+            memcpy(&size, &log->data[pos - RECORD_TRAILER_SIZE], sizeof(size));
+            pos -= size;
+        } else {
+            memcpy(&size, &log->data[pos], sizeof(size));
+        }
+        *next = back ? offset - size : offset + size;
+        return decodeRecord(log, &log->data[pos], size, action, blocks);
+    }
+
+    if (!log->spill)
+        return false;
+
+    uint64_t start = offset;
+    if (back) {
+        if (offset < RECORD_TRAILER_SIZE ||
+            !spillRead(log, offset - RECORD_TRAILER_SIZE, &size, sizeof(size)))
+            return false;
+        if (size > offset)
+            return false;
+        start = offset - size;
+    } else if (!spillRead(log, offset, &size, sizeof(size))) {
+        return false;
+    }
+
+    if (size > log->base - start)
+        return false;
+
+    *next = back ? start : start + size;
+    if (start + size <= log->map_end) {
+        return decodeRecord(log, &log->map[log->spill_start + start], size,
+                            action, blocks);
+    }
+
+    char* record = malloc_s(size);
+    bool result = spillRead(log, start, record, size) &&
+                  decodeRecord(log, record, size, action, blocks);
+    free(record);
+    return result;
+}
+
+// Drop the redo tail
+static void logTruncate(EditorUndoLog* log) {
+    if (log->current >= log->base) {
+        log->len = log->current - log->base;
+    } else {
+        log->len = 0;
+        log->base = log->current;
+    }
+
+    if (log->synced > log->current)
+        log->synced = log->current;
+    if (log->map_end > log->current)
+        log->map_end = log->current;
+
+    while (log->blocks.size > 0 &&
+           log->blocks.data[log->blocks.size - 1].offset >= log->current) {
+        editorFreeClipboardContent(&log->blocks.data[--log->blocks.size].text);
+    }
+}
+
+// Move the oldest records to the spill file until the arena is half the
+// limit. The last record stays so it can still be merged.
+static void logSpill(EditorUndoLog* log) {
+    size_t limit = (size_t)undo_memory.int_value * 1024 * 1024;
+    if (log->len <= limit)
+        return;
+
+    size_t cut = 0;
+    while (log->len - cut > limit / 2) {
+        uint64_t size;
+        memcpy(&size, &log->data[cut], sizeof(size));
+        if (cut + size >= log->len)
+            break;
+        cut += size;
+    }
+    if (cut == 0)
+        return;
+
+    if (!log->spill) {
+        log->spill = openTempFile();
+        if (!log->spill)
+            return;
+    }
+
+    // Records already in the journal are only dropped
+    size_t from = log->synced > log->base ? log->synced - log->base : 0;
+    if (from < cut &&
+        (!seekFile(log->spill, log->spill_start + log->base + from) ||
+         fwrite(&log->data[from], 1, cut - from, log->spill) != cut - from))
+        return;
+
+    log->len -= cut;
+    log->base += cut;
+    memmove(log->data, &log->data[cut], log->len);
+
+    if (log->capacity > limit && log->len < log->capacity / 4) {
+        size_t capacity = log->len * 2;
+        if (capacity < UNDO_LOG_MIN_CAPACITY)
+            capacity = UNDO_LOG_MIN_CAPACITY;
+        log->data = realloc_s(log->data, capacity);
+        log->capacity = capacity;
+    }
+}
+
+// Undo journal
+
+#define UNDO_JOURNAL_DIR "undo"
+#define UNDO_JOURNAL_MAGIC "NINOUNDO"
+#define UNDO_JOURNAL_VERSION 1
+#define UNDO_JOURNAL_BYTE_ORDER 0x01020304
+// The records of the saved state were overwritten
+#define UNDO_JOURNAL_NO_SAVED UINT64_MAX
+
+// Followed by the log
+typedef struct UndoJournalHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t path_hash;
+    uint64_t content_hash;  // File at the saved state
+    uint64_t saved;         // Log offset of the saved state
+    uint64_t end;
+} UndoJournalHeader;
+
+static uint64_t hashPath(const char* path) {
+    return hashBytes(path, strlen(path), 0);
+}
+
+// Content as it's written to the disk
+static uint64_t hashFileContent(const EditorFile* file) {
+    const char* newline = file->newline == NL_DOS ? "\r\n" : "\n";
+    uint64_t hash = 0;
+    for (int i = 0; i < file->num_rows; i++) {
+        if (i != 0)
+            hash = hashBytes(newline, strlen(newline), hash);
+        hash = hashBytes(file->row[i].data, file->row[i].size, hash);
+    }
+    return hash;
+}
+
+static bool getJournalPath(uint64_t path_hash, char* path, size_t size) {
+    const char* home_dir = getEnv(ENV_HOME);
+    if (!home_dir)
+        return false;
+
+    int len = snprintf(path, size, PATH_CAT("%s", CONF_DIR, UNDO_JOURNAL_DIR),
+                       home_dir);
+    if (len < 0 || (size_t)len >= size)
+        return false;
+
+    // Create the config directory on the way
+    for (int i = (int)strlen(home_dir) + 1; i < len; i++) {
+        if (path[i] == DIR_SEP[0]) {
+            path[i] = '\0';
+            makeDir(path);
+            path[i] = DIR_SEP[0];
+        }
+    }
+    if (!makeDir(path))
+        return false;
+
+    int name_len = snprintf(&path[len], size - len, DIR_SEP "%016llx",
+                            (unsigned long long)path_hash);
+    return name_len > 0 && (size_t)(len + name_len) < size;
+}
+
+// Stop writing to the journal, it's invalidated and only kept as the spill
+// file
+static void journalDrop(EditorUndoLog* log) {
+    char magic[sizeof(UNDO_JOURNAL_MAGIC) - 1] = {0};
+    if (seekFile(log->spill, 0))
+        fwrite(magic, 1, sizeof(magic), log->spill);
+    log->journal = false;
+}
+
+static void journalSync(EditorUndoLog* log) {
+    if (!log->journal)
+        return;
+
+    // Records are rewritten from synced on, the saved state is lost first
+    if (log->saved != UNDO_JOURNAL_NO_SAVED && log->saved > log->synced) {
+        log->saved = UNDO_JOURNAL_NO_SAVED;
+        if (!seekFile(log->spill, offsetof(UndoJournalHeader, saved)) ||
+            fwrite(&log->saved, sizeof(log->saved), 1, log->spill) != 1) {
+            editorMsg("Failed to write the undo journal.");
+            journalDrop(log);
+            return;
+        }
+    }
+
+    uint64_t end = log->base + log->len;
+    size_t from = log->synced - log->base;
+    if (!seekFile(log->spill, log->spill_start + log->synced) ||
+        fwrite(&log->data[from], 1, log->len - from, log->spill) !=
+            log->len - from ||
+        !seekFile(log->spill, offsetof(UndoJournalHeader, end)) ||
+        fwrite(&end, sizeof(end), 1, log->spill) != 1) {
+        editorMsg("Failed to write the undo journal.");
+        journalDrop(log);
+        return;
+    }
+    log->synced = end;
+}
+
+void editorFlushUndoJournals(void) {
+    for (int i = 0; i < EDITOR_FILE_MAX_SLOT; i++) {
+        EditorUndoLog* log = &gEditor.files[i].undo;
+        if (gEditor.files[i].reference_count == 0 || !log->journal)
+            continue;
+        if (fflush(log->spill) != 0) {
+            editorMsg("Failed to write the undo journal.");
+            journalDrop(log);
+        }
+    }
+}
+
 bool editorUndo(EditorTab* tab) {
     EditorFile* file = editorTabGetFile(tab);
+    EditorUndoLog* log = &file->undo;
 
-    if (file->action_current == file->action_head)
+    if (log->current == 0)
         return false;
 
     if (file->read_only && !file->unlocked) {
@@ -113,28 +649,39 @@ bool editorUndo(EditorTab* tab) {
         return false;
     }
 
-    switch (file->action_current->action->type) {
+    EditorAction action;
+    int32_t blocks[2];
+    uint64_t prev;
+    if (!logReadRecord(log, log->current, true, &action, blocks, &prev)) {
+        editorMsg("Failed to read the undo history.");
+        return false;
+    }
+
+    switch (action.type) {
         case ACTION_EDIT: {
-            EditAction* edit = &file->action_current->action->edit;
+            EditAction* edit = &action.edit;
             editorApplyEdit(tab, &edit->data, true);
             tab->cursor = edit->old_cursor;
         } break;
 
         case ACTION_ATTRI: {
-            AttributeAction* attri = &file->action_current->action->attri;
+            AttributeAction* attri = &action.attri;
             file->newline = attri->old_newline;
         } break;
     }
 
-    file->action_current = file->action_current->prev;
+    logReturnBlocks(log, &action, blocks);
+    editorFreeActionContent(&action);
+    log->current = prev;
     file->dirty--;
     return true;
 }
 
 bool editorRedo(EditorTab* tab) {
     EditorFile* file = editorTabGetFile(tab);
+    EditorUndoLog* log = &file->undo;
 
-    if (!file->action_current->next)
+    if (log->current == log->base + log->len)
         return false;
 
     if (file->read_only && !file->unlocked) {
@@ -142,21 +689,30 @@ bool editorRedo(EditorTab* tab) {
         return false;
     }
 
-    file->action_current = file->action_current->next;
+    EditorAction action;
+    int32_t blocks[2];
+    uint64_t next;
+    if (!logReadRecord(log, log->current, false, &action, blocks, &next)) {
+        editorMsg("Failed to read the undo history.");
+        return false;
+    }
 
-    switch (file->action_current->action->type) {
+    switch (action.type) {
         case ACTION_EDIT: {
-            EditAction* edit = &file->action_current->action->edit;
+            EditAction* edit = &action.edit;
             editorApplyEdit(tab, &edit->data, false);
             tab->cursor = edit->new_cursor;
         } break;
 
         case ACTION_ATTRI: {
-            AttributeAction* attri = &file->action_current->action->attri;
+            AttributeAction* attri = &action.attri;
             file->newline = attri->new_newline;
         } break;
     }
 
+    logReturnBlocks(log, &action, blocks);
+    editorFreeActionContent(&action);
+    log->current = next;
     file->dirty++;
     return true;
 }
@@ -165,44 +721,267 @@ void editorAppendAction(EditorFile* file, EditorAction* action) {
     if (!action)
         return;
 
-    EditorActionList* node = malloc_s(sizeof(EditorActionList));
-    node->action = action;
-    node->next = NULL;
+    EditorUndoLog* log = &file->undo;
+    logTruncate(log);
+    logWriteRecord(log, action);
+    log->current = log->base + log->len;
+    editorFreeActionContent(action);
 
     file->dirty++;
 
-    editorFreeActionList(file->action_current->next);
+    journalSync(log);
+    logSpill(log);
+}
 
-    if (file->action_current == file->action_head) {
-        file->action_head->next = node;
-        node->prev = file->action_head;
-        file->action_current = node;
-        return;
+static bool isLineInsert(const Edit* edit) {
+    return edit->before.size == 0 && edit->after.size == 1;
+}
+
+static bool isLineDelete(const Edit* edit) {
+    return edit->before.size == 1 && edit->after.size == 0;
+}
+
+// Replace remove bytes at `at` in a line of the last record with s. line is
+// the offset of the line size.
+static void logSpliceLine(EditorUndoLog* log,
+                          size_t record,
+                          size_t line,
+                          int at,
+                          int remove,
+                          const char* s,
+                          int len) {
+    int32_t line_size;
+    memcpy(&line_size, &log->data[line], sizeof(line_size));
+
+    size_t pos = line + sizeof(line_size) + at;
+    size_t tail = log->len - pos - remove;
+    if (len > remove)
+        logReserve(log, len - remove);
+    memmove(&log->data[pos + len], &log->data[pos + remove], tail);
+    if (len > 0)
+        memcpy(&log->data[pos], s, len);
+    log->len += len - remove;
+
+    line_size += len - remove;
+    memcpy(&log->data[line], &line_size, sizeof(line_size));
+
+    uint64_t size = log->len - record;
+    memcpy(&log->data[record], &size, sizeof(size));
+    memcpy(&log->data[log->len - RECORD_TRAILER_SIZE], &size, sizeof(size));
+}
+
+bool editorMergeEdit(EditorFile* file,
+                     Edit* edit,
+                     EditorCursor new_cursor,
+                     int64_t time_ms) {
+    EditorUndoLog* log = &file->undo;
+    // Don't merge into the saved state, the action before a redo or a
+    // spilled action
+    if (log->current == 0 || log->current != log->base + log->len ||
+        log->len == 0 || file->dirty == 0)
+        return false;
+
+    uint64_t size;
+    memcpy(&size, &log->data[log->len - RECORD_TRAILER_SIZE], sizeof(size));
+    size_t record = log->len - size;
+    const char* rec = &log->data[record];
+    if (rec[RECORD_HEADER_SIZE - 1] != ACTION_EDIT)
+        return false;
+
+    int32_t x, y;
+    int64_t prev_time;
+    memcpy(&x, &rec[EDIT_X_OFFSET], sizeof(x));
+    memcpy(&y, &rec[EDIT_X_OFFSET + 4], sizeof(y));
+    memcpy(&prev_time, &rec[EDIT_TIME_OFFSET], sizeof(prev_time));
+    if (time_ms - prev_time > EDIT_MERGE_MS || y != edit->y)
+        return false;
+
+    // A single line inserted or deleted
+    int32_t before_count, after_count, line_size;
+    size_t line;
+    memcpy(&before_count, &rec[EDIT_BEFORE_OFFSET], sizeof(before_count));
+    if (before_count == 0) {
+        memcpy(&after_count, &rec[EDIT_BEFORE_OFFSET + 4], sizeof(after_count));
+        line = record + EDIT_BEFORE_OFFSET + 8;
+        memcpy(&line_size, &log->data[line], sizeof(line_size));
+        if (after_count != 1)
+            return false;
+    } else if (before_count == 1) {
+        line = record + EDIT_BEFORE_OFFSET + 4;
+        memcpy(&line_size, &log->data[line], sizeof(line_size));
+        memcpy(&after_count, &log->data[line + 4 + line_size],
+               sizeof(after_count));
+        if (after_count != 0)
+            return false;
+    } else {
+        return false;
     }
 
-    node->prev = file->action_current;
-    file->action_current->next = node;
-    file->action_current = file->action_current->next;
+    if (before_count == 0) {
+        int end = x + line_size;
+        if (isLineInsert(edit) && edit->x == end) {
+            const Str* s = &edit->after.lines[0];
+            logSpliceLine(log, record, line, line_size, 0, s->data, s->size);
+        } else if (isLineDelete(edit) && edit->x > x &&
+                   edit->x + edit->before.lines[0].size == end) {
+            // Backspace over the typed text
+            int count = edit->before.lines[0].size;
+            logSpliceLine(log, record, line, line_size - count, count, NULL, 0);
+        } else {
+            return false;
+        }
+    } else if (isLineDelete(edit)) {
+        const Str* s = &edit->before.lines[0];
+        if (edit->x + s->size == x) {
+            // Backspace
+            logSpliceLine(log, record, line, 0, 0, s->data, s->size);
+            x = edit->x;
+            memcpy(&log->data[record + EDIT_X_OFFSET], &x, sizeof(x));
+        } else if (edit->x == x) {
+            // Delete
+            logSpliceLine(log, record, line, line_size, 0, s->data, s->size);
+        } else {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    // Cursor and time are written in place, the record is the last one
+    size_t len = log->len;
+    log->len = record + EDIT_NEW_CURSOR_OFFSET;
+    logWriteCursor(log, &new_cursor);
+    logWrite(log, &time_ms, sizeof(time_ms));
+    log->len = len;
+    log->current = log->base + log->len;
+
+    if (log->synced > log->base + record)
+        log->synced = log->base + record;
+    journalSync(log);
+
+    editorFreeClipboardContent(&edit->before);
+    editorFreeClipboardContent(&edit->after);
+    return true;
 }
 
-void editorFreeAction(EditorAction* action) {
-    if (!action)
+void editorFreeUndoLog(EditorUndoLog* log) {
+    for (uint32_t i = 0; i < log->blocks.size; i++) {
+        editorFreeClipboardContent(&log->blocks.data[i].text);
+    }
+    vector_free(log->blocks);
+    free(log->data);
+    if (log->spill)
+        fclose(log->spill);
+    if (log->map)
+        unmapFile(log->map, log->map_size);
+    memset(log, 0, sizeof(EditorUndoLog));
+}
+
+void editorOpenUndoJournal(EditorFile* file) {
+    EditorUndoLog* log = &file->undo;
+    if (!undo_journal.int_value || !file->filename || log->spill)
         return;
 
-    if (action->type == ACTION_EDIT) {
-        editorFreeClipboardContent(&action->edit.data.before);
-        editorFreeClipboardContent(&action->edit.data.after);
+    UndoJournalHeader header = {
+        .version = UNDO_JOURNAL_VERSION,
+        .byte_order = UNDO_JOURNAL_BYTE_ORDER,
+        .path_hash = hashPath(file->filename),
+        .content_hash = hashFileContent(file),
+    };
+    memcpy(header.magic, UNDO_JOURNAL_MAGIC, sizeof(header.magic));
+
+    char path[EDITOR_PATH_MAX];
+    if (!getJournalPath(header.path_hash, path, sizeof(path)))
+        return;
+
+    // Never truncated, the journal there may still be valid
+    log->spill = openFile(path, "r+b");
+    if (!log->spill && getFileType(path) == FT_NOT_EXIST) {
+        FILE* fp = openFile(path, "ab");
+        if (fp) {
+            fclose(fp);
+            log->spill = openFile(path, "r+b");
+        }
+    }
+    if (!log->spill)
+        return;
+
+    // Another instance is editing the file, spill to a temp file instead
+    if (!lockFile(log->spill)) {
+        fclose(log->spill);
+        log->spill = NULL;
+        return;
+    }
+    log->spill_start = sizeof(UndoJournalHeader);
+
+    // The history is kept if the file is still what was last saved
+    UndoJournalHeader old;
+    if (fread(&old, sizeof(old), 1, log->spill) == 1 &&
+        memcmp(old.magic, header.magic, sizeof(header.magic)) == 0 &&
+        old.version == header.version &&
+        old.byte_order == header.byte_order &&
+        old.path_hash == header.path_hash &&
+        old.content_hash == header.content_hash &&
+        old.saved != UNDO_JOURNAL_NO_SAVED && old.saved <= old.end) {
+        // Records are read from the mapping, the header through the handle
+        size_t map_size;
+        char* map = mapFile(path, &map_size);
+        if (map && map_size >= sizeof(UndoJournalHeader) &&
+            old.end <= map_size - sizeof(UndoJournalHeader)) {
+            log->map = map;
+            log->map_size = map_size;
+            log->map_end = old.end;
+            log->base = old.end;
+            log->current = old.saved;
+            log->synced = old.end;
+            log->saved = old.saved;
+            log->journal = true;
+            return;
+        }
+        if (map)
+            unmapFile(map, map_size);
     }
 
-    free(action);
+    if (!seekFile(log->spill, 0) ||
+        fwrite(&header, sizeof(header), 1, log->spill) != 1) {
+        fclose(log->spill);
+        log->spill = NULL;
+        log->spill_start = 0;
+        return;
+    }
+    log->journal = true;
 }
 
-void editorFreeActionList(EditorActionList* thisptr) {
-    EditorActionList* temp;
-    while (thisptr) {
-        temp = thisptr;
-        thisptr = thisptr->next;
-        editorFreeAction(temp->action);
-        free(temp);
+void editorSaveUndoJournal(EditorFile* file) {
+    EditorUndoLog* log = &file->undo;
+    if (!log->journal)
+        return;
+
+    UndoJournalHeader header = {
+        .version = UNDO_JOURNAL_VERSION,
+        .byte_order = UNDO_JOURNAL_BYTE_ORDER,
+        .path_hash = hashPath(file->filename),
+        .content_hash = hashFileContent(file),
+        .saved = log->current,
+        .end = log->synced,
+    };
+    memcpy(header.magic, UNDO_JOURNAL_MAGIC, sizeof(header.magic));
+
+    // Saved as another file
+    UndoJournalHeader old;
+    if (!seekFile(log->spill, 0) ||
+        fread(&old, sizeof(old), 1, log->spill) != 1 ||
+        old.path_hash != header.path_hash) {
+        journalDrop(log);
+        return;
+    }
+
+    if (!seekFile(log->spill, 0) ||
+        fwrite(&header, sizeof(header), 1, log->spill) != 1 ||
+        fflush(log->spill) != 0) {
+        editorMsg("Failed to write the undo journal.");
+        journalDrop(log);
+        return;
     }
+    log->saved = log->current;
 }
@@ -12,16 +12,27 @@ typedef struct EditorCursor {
     int select_y;
 } EditorCursor;
 
+// Edits spanning at least this many lines move the row buffers in and out of
+// the file instead of copying them
+#define EDIT_MOVE_MIN_LINES 1024
+
 typedef struct Edit {
     int x, y;
     EditorClipboard before;
     EditorClipboard after;
+    // Moved texts only hold their lines while they are not in the file
+    bool move_before;
+    bool move_after;
 } Edit;
 
+// Keystrokes closer than this can be merged into one undo step
+#define EDIT_MERGE_MS 1000
+
 typedef struct EditAction {
     Edit data;
     EditorCursor old_cursor;
     EditorCursor new_cursor;
+    int64_t time_ms;  // Last keystroke in the action
 } EditAction;
 
 typedef struct AttributeAction {
@@ -42,17 +53,69 @@ typedef struct EditorAction {
     };
 } EditorAction;
 
-typedef struct EditorActionList {
-    struct EditorActionList* prev;
-    struct EditorActionList* next;
-    EditorAction* action;
-} EditorActionList;
+// Undo history of a file. Actions are appended as records to an arena:
+//   u64 size | u8 type | payload | u64 size
+// The size at the end lets undo walk backwards. When the arena grows past
+// undo_memory, the oldest records are moved to a temp file and only read back
+// when undo reaches them. Moved texts stay in memory as blocks.
+//
+// With undo_journal, the spill file is a journal in the config directory
+// instead, keyed by the file path. Records are written to it as they are
+// added, and it's mapped on reopen if the file still matches the last save.
+typedef struct EditorUndoBlock {
+    uint64_t offset;  // Record using it
+    EditorClipboard text;
+} EditorUndoBlock;
+
+typedef struct EditorUndoLog {
+    char* data;
+    size_t len;
+    size_t capacity;
+
+    // Moved texts are kept out of the records
+    VECTOR(EditorUndoBlock) blocks;
 
+    uint64_t base;     // Log offset of data[0], older records are spilled
+    uint64_t current;  // End of the last applied record
+    FILE* spill;
+    uint64_t spill_start;  // File offset of the log start
+
+    bool journal;
+    uint64_t synced;  // Log bytes written to the journal
+    uint64_t saved;   // Saved state in the journal header
+
+    // Journal from the last session, read instead of the spill file below
+    // map_end
+    char* map;
+    size_t map_size;
+    uint64_t map_end;
+} EditorUndoLog;
+
+// Whether an edit can move this many lines instead of copying them
+bool editorEditCanMove(const EditorFile* file, size_t lines);
+// Set the text removed by an edit. Large texts are moved out of the file when
+// the edit is applied.
+void editorEditSetBefore(EditorFile* file,
+                         Edit* edit,
+                         EditorSelectRange range);
 void editorApplyEdit(EditorTab* tab, Edit* edit, bool undo);
 bool editorUndo(EditorTab* tab);
 bool editorRedo(EditorTab* tab);
+// Records the action and frees its content
 void editorAppendAction(EditorFile* file, EditorAction* action);
-void editorFreeActionList(EditorActionList* thisptr);
-void editorFreeAction(EditorAction* action);
+// Merge an applied keystroke edit into the last action if it continues it.
+// On success the edit content is freed.
+bool editorMergeEdit(EditorFile* file,
+                     Edit* edit,
+                     EditorCursor new_cursor,
+                     int64_t time_ms);
+void editorFreeUndoLog(EditorUndoLog* log);
+
+// Load the journal of a newly opened file or start a new one
+void editorOpenUndoJournal(EditorFile* file);
+// Mark the current state as saved in the journal
+void editorSaveUndoJournal(EditorFile* file);
+// Write buffered journal records to the disk, called once per frame
+void editorFlushUndoJournals(void);
 
 #endif
@@ -27,4 +27,7 @@ void* _malloc_s(const char* file, int line, size_t size);
 void* _calloc_s(const char* file, int line, size_t n, size_t size);
 void* _realloc_s(const char* file, int line, void* ptr, size_t size);
 
+// Calls to the functions above, only made from the main thread
+extern uint64_t alloc_count;
+
 #endif
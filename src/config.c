@@ -12,6 +12,7 @@ static void cvarTabSizeCallback(void);
 static void cvarSyntaxCallback(void);
 static void cvarExplorerCallback(void);
 static void cvarMouseCallback(void);
+static void cvarWrapCallback(void);
 
 CONVAR(tabsize, "4", "Tab size.", true, 1, true, 16, cvarTabSizeCallback);
 CONVAR(whitespace, "1", "Use whitespace instead of tab.");
@@ -68,10 +69,33 @@ CONVAR(ttimeoutlen,
        0,
        false,
        0);
+CONVAR(max_fps,
+       "60",
+       "Max frames per second. Input arriving faster is drawn together. 0 "
+       "is unlimited.",
+       true,
+       0,
+       false,
+       0);
 CONVAR(lineno, "1", "Show line numbers.");
+CONVAR(wrap, "0", "Soft wrap long lines.", cvarWrapCallback);
 CONVAR(readonly, "0", "Open files in read-only mode.");
+CONVAR(undo_memory,
+       "64",
+       "Undo history in MB kept in memory per file. Older history is moved "
+       "to a temp file.",
+       true,
+       1,
+       false,
+       0);
+CONVAR(undo_journal,
+       "0",
+       "Keep the undo history of files across sessions in the config "
+       "directory.");
 
-CONVAR(developer, "0", "Set developer message level.");
+CONVAR(developer,
+       "0",
+       "Set developer message level. 2 also shows frame timings.");
 
 static void reloadSyntax(void) {
     for (int i = 0; i < EDITOR_FILE_MAX_SLOT; i++) {
@@ -113,6 +137,20 @@ static void cvarExplorerCallback(void) {
     reloadExplorer();
 }
 
+static void cvarWrapCallback(void) {
+    for (int i = 0; i < EDITOR_FILE_MAX_SLOT; i++) {
+        editorFreeWrapLayouts(&gEditor.files[i]);
+    }
+
+    for (int i = 0; i < gEditor.split_count; i++) {
+        EditorSplit* split = &gEditor.splits[i];
+        for (int j = 0; j < split->tab_count; j++) {
+            split->tabs[j].col_offset = 0;
+            split->tabs[j].wrap_offset = 0;
+        }
+    }
+}
+
 static void cvarMouseCallback(void) {
     bool mode = !!mouse.int_value;
     if (gEditor.mouse_mode != mode) {
@@ -307,9 +345,7 @@ CON_COMMAND(hldb_load, "Load a syntax highlighting JSON file.") {
 CON_COMMAND(hldb_reload_all, "Reload syntax highlighting database.") {
     UNUSED(args.argc);
 
-    editorFreeHLDB();
-    editorInitHLDB();
-    reloadSyntax();
+    editorReloadHLDB();
 }
 
 CON_COMMAND(newline, "Set the EOL sequence (LF/CRLF).") {
@@ -345,14 +381,13 @@ CON_COMMAND(newline, "Set the EOL sequence (LF/CRLF).") {
         return;
     }
 
-    EditorAction* action = calloc_s(1, sizeof(EditorAction));
-    action->type = ACTION_ATTRI;
-    action->attri.new_newline = nl;
-    action->attri.old_newline = file->newline;
+    EditorAction action = {.type = ACTION_ATTRI};
+    action.attri.new_newline = nl;
+    action.attri.old_newline = file->newline;
 
     file->newline = nl;
 
-    editorAppendAction(file, action);
+    editorAppendAction(file, &action);
 }
 
 CON_COMMAND(unlock, "Allow editing a read-only file.") {
@@ -403,9 +438,8 @@ CON_COMMAND(reload, "Reload the current file from disk.") {
             int reference_count = curr_file->reference_count;
             editorFreeFile(curr_file);
             *curr_file = temp_file;
-            curr_file->action_head = calloc_s(1, sizeof(EditorActionList));
-            curr_file->action_current = curr_file->action_head;
             curr_file->reference_count = reference_count;
+            editorOpenUndoJournal(curr_file);
 
             int max_y = curr_file->num_rows > 0 ? curr_file->num_rows - 1 : 0;
             for (int i = 0; i < gEditor.split_count; i++) {
@@ -421,6 +455,7 @@ CON_COMMAND(reload, "Reload the current file from disk.") {
                         tab->cursor.is_selected = false;
                         tab->sx = 0;
                         tab->col_offset = 0;
+                        tab->wrap_offset = 0;
                     }
                 }
             }
@@ -1015,8 +1050,12 @@ void editorRegisterCommands(void) {
     editorInitConVar(&ex_show_hidden);
     editorInitConVar(&newline_default);
     editorInitConVar(&ttimeoutlen);
+    editorInitConVar(&max_fps);
     editorInitConVar(&lineno);
+    editorInitConVar(&wrap);
     editorInitConVar(&readonly);
+    editorInitConVar(&undo_memory);
+    editorInitConVar(&undo_journal);
 
     editorInitConCommand(&color);
     editorInitConCommand(&lang);
@@ -1042,9 +1081,10 @@ void editorRegisterCommands(void) {
 
     editorInitConCommand(&quit);
 
+    editorInitConVar(&developer);
+
 #ifndef NDEBUG
     editorInitConCommand(&crash);
-    editorInitConVar(&developer);
 #endif
 }
 
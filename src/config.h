@@ -130,8 +130,12 @@ extern ConVar ex_default_width;
 extern ConVar ex_show_hidden;
 extern ConVar newline_default;
 extern ConVar ttimeoutlen;
+extern ConVar max_fps;
 extern ConVar lineno;
+extern ConVar wrap;
 extern ConVar readonly;
+extern ConVar undo_memory;
+extern ConVar undo_journal;
 extern ConVar shell;
 extern ConVar developer;
 
@@ -52,8 +52,10 @@ void editorFreeFile(EditorFile* file) {
     for (int i = 0; i < file->num_rows; i++) {
         editorFreeRow(&file->row[i]);
     }
-    editorFreeActionList(file->action_head);
+    editorFreeUndoLog(&file->undo);
     free(file->row);
+    editorFreeHLCache(&file->hl_cache);
+    editorFreeWrapLayouts(file);
     free(file->filename);
 }
 
@@ -91,8 +93,6 @@ int editorAddFile(EditorFile* file) {
     EditorFile* current = &gEditor.files[index];
 
     *current = *file;
-    current->action_head = calloc_s(1, sizeof(EditorActionList));
-    current->action_current = current->action_head;
     current->reference_count = 0;
 
     return index;
@@ -105,7 +105,7 @@ void editorRemoveFile(int file_index) {
     EditorFile* file = &gEditor.files[file_index];
     if (file->reference_count <= 0) {
         // Likely during the file creation
-        if (file->row || file->filename || file->action_head) {
+        if (file->row || file->filename) {
             editorFreeFile(file);
             memset(file, 0, sizeof(EditorFile));
         }
@@ -6,9 +6,11 @@
 #include "file_io.h"
 #include "os.h"
 #include "output.h"
+#include "perf.h"
 #include "row.h"
 #include "select.h"
 #include "terminal.h"
+#include "wrap.h"
 
 #define EDITOR_FILE_MAX_SLOT 32
 #define EDITOR_SPLIT_MAX 4
@@ -49,6 +51,7 @@ typedef struct EditorTab {
     // Editor offsets
     int row_offset;
     int col_offset;
+    int wrap_offset;  // First visual line of row_offset shown when wrapping
 
     // Find
     bool has_match;
@@ -90,17 +93,20 @@ typedef struct EditorFile {
 
     // Syntax highlight information
     EditorSyntax* syntax;
+    EditorHLCache hl_cache;
+
+    // Soft wrap layouts
+    EditorWrapLayout wrap[WRAP_LAYOUT_MAX];
 
     // Undo redo
     int dirty;
-    EditorActionList* action_head;
-    EditorActionList* action_current;
+    EditorUndoLog undo;
 } EditorFile;
 
 typedef struct Editor {
     // Screen
-    ScreenCell** screen;
-    ScreenCell** prev_screen;
+    ScreenRow* screen;
+    ScreenRow* prev_screen;
     int screen_rows;
     int screen_cols;
     int old_screen_rows;
@@ -114,6 +120,9 @@ typedef struct Editor {
     int state;
     bool mouse_mode;
 
+    // Terminal supports synchronized output
+    bool sync_output;
+
     // Cursor position for prompt
     int px;
 
@@ -157,6 +166,9 @@ typedef struct Editor {
 
     // Input
     EditorInput pending_input;
+
+    // Developer overlay
+    EditorPerf perf;
 } Editor;
 
 // Text editor
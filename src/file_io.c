@@ -82,6 +82,7 @@ static void editorLoadRowsFromStream(EditorFile* file, FILE* fp) {
     int64_t len;
 
     file->row = malloc_s(sizeof(EditorRow) * 16);
+    file->row_capacity = 16;
 
     while ((len = getLine(&line, &n, fp)) != -1) {
         has_end_nl = false;
@@ -205,12 +206,18 @@ OpenStatus editorLoadFile(EditorFile* file, const char* path, bool reload) {
 
     if (!fp) {
         editorInsertRow(file, 0, "", 0);
+        if (!reload)
+            editorOpenUndoJournal(file);
         return OPEN_FILE_NEW;
     }
 
     editorLoadRowsFromStream(file, fp);
     fclose(fp);
 
+    // On reload, the journal is opened after the old file is freed
+    if (!reload)
+        editorOpenUndoJournal(file);
+
     return OPEN_FILE;
 }
 
@@ -274,6 +281,7 @@ bool editorSave(EditorFile* file, int save_as) {
     }
 
     file->dirty = 0;
+    editorSaveUndoJournal(file);
     editorMsg("%d bytes written to disk.", len);
 
     // Since we save by replacing the file, we need to refresh file info
@@ -1,5 +1,11 @@
 #include "highlight.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HL_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 #include "../resources/bundle.h"
 #include "config.h"
 #include "editor.h"
@@ -20,298 +26,655 @@ static uint32_t editorRowCountTrailingSpaces(const EditorRow* row) {
     return count;
 }
 
-int editorUpdateSyntax(EditorFile* file, EditorRow* r, int flags) {
-    const EditorSyntax* s = file->syntax;
+// Bytes that continue an identifier, see isIdentifierChar
+static bool hl_ident_table[256];
 
-    bool lazy = flags & HL_UPDATE_LAZY;
-    bool single_line = flags & HL_UPDATE_SINGLE_LINE;
+static void editorInitIdentTable(void) {
+    for (int c = 0; c < 256; c++) {
+        hl_ident_table[c] = isIdentifierChar((char)c);
+    }
+}
 
-    if (!lazy)
-        r->trailing_spaces = editorRowCountTrailingSpaces(r);
+// Find the first occurrence of needle in data[start, end), or -1.
+static inline int hlFindStr(const char* data,
+                            int start,
+                            int end,
+                            const char* needle,
+                            int needle_len) {
+    while (start + needle_len <= end) {
+        const char* p =
+            memchr(&data[start], needle[0], end - needle_len + 1 - start);
+        if (!p)
+            return -1;
+        if (memcmp(p + 1, needle + 1, needle_len - 1) == 0)
+            return (int)(p - data);
+        start = (int)(p - data) + 1;
+    }
+    return -1;
+}
 
-    if (!syntax.int_value || !s) {
-        vector_clear(r->hl_spans);
-        r->hl_updated = !lazy;
-        return 1;
+// Find the first a or b in data[start, end), or -1.
+static inline int hlFindEither(const char* data,
+                               int start,
+                               int end,
+                               char a,
+                               char b) {
+    int i = start;
+
+#ifdef HL_USE_SSE2
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    while (i + 16 <= end) {
+        __m128i v = _mm_loadu_si128((const __m128i*)&data[i]);
+        __m128i eq = _mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb));
+        if (_mm_movemask_epi8(eq))
+            break;
+        i += 16;
+    }
+#else
+    // Word-at-a-time zero byte test on (v ^ a) and (v ^ b)
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    const uint64_t wa = ones * (uint8_t)a;
+    const uint64_t wb = ones * (uint8_t)b;
+    while (i + 8 <= end) {
+        uint64_t v;
+        memcpy(&v, &data[i], sizeof(v));
+        uint64_t xa = v ^ wa;
+        uint64_t xb = v ^ wb;
+        if (((xa - ones) & ~xa & highs) | ((xb - ones) & ~xb & highs))
+            break;
+        i += 8;
     }
+#endif
 
-    const char* scs = s->singleline_comment_start;
-    const char* mcs = s->multiline_comment_start;
-    const char* mce = s->multiline_comment_end;
+    for (; i < end; i++) {
+        if (data[i] == a || data[i] == b)
+            return i;
+    }
+    return -1;
+}
 
-    const int scs_len = scs ? strlen(scs) : 0;
-    const int mcs_len = mcs ? strlen(mcs) : 0;
-    const int mce_len = mce ? strlen(mce) : 0;
+// Spans of the row being highlighted, packed the same way as the cache pool
+static VECTOR(uint8_t) hl_scratch;
+static uint32_t hl_scratch_pos;
 
-    bool do_next_row = true;
-    int row_index = (int)(r - file->row);
+static inline void hlWriteVarint(uint32_t value) {
+    while (value >= 0x80) {
+        vector_push(hl_scratch, (uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    vector_push(hl_scratch, (uint8_t)value);
+}
 
-    int processed_rows = 0;
+static void hlEmitSpan(uint32_t start, uint32_t len, EditorHLType type) {
+    hlWriteVarint(((start - hl_scratch_pos) << 4) | type);
+    hlWriteVarint(len);
+    hl_scratch_pos = start + len;
+}
 
-    while (do_next_row && row_index < file->num_rows) {
-        EditorRow* row = &file->row[row_index];
+static inline bool editorRowHasHL(const EditorFile* file,
+                                  const EditorRow* row) {
+    const EditorHLCache* cache = &file->hl_cache;
+    return row->hl_entry && row->hl_entry < cache->entries.size &&
+           cache->entries.data[row->hl_entry].gen == row->hl_gen;
+}
 
-        vector_clear(row->hl_spans);
-        row->hl_updated = !lazy;
+static inline void hlCacheUnlink(EditorHLCache* cache, uint32_t index) {
+    EditorHLEntry* entries = cache->entries.data;
+    entries[entries[index].prev].next = entries[index].next;
+    entries[entries[index].next].prev = entries[index].prev;
+}
 
-        do_next_row = false;
+static inline void hlCacheLinkFront(EditorHLCache* cache, uint32_t index) {
+    EditorHLEntry* entries = cache->entries.data;
+    entries[index].prev = 0;
+    entries[index].next = entries[0].next;
+    entries[entries[0].next].prev = index;
+    entries[0].next = index;
+}
 
-        bool prev_sep = true;
-        // TODO: support single-line comments/strings that end with '\' in C/C++
-        bool in_comment =
-            (row_index > 0 && file->row[row_index - 1].hl_open_comment);
+static inline uint32_t* hlCacheBucket(EditorHLCache* cache, uint64_t hash) {
+    return &cache->buckets[hash & (HL_CACHE_BUCKETS - 1)];
+}
 
-        int i = 0;
-        while (i < row->size) {
-            char c = row->data[i];
+static uint32_t hlCacheLookup(EditorHLCache* cache,
+                              uint64_t hash,
+                              const EditorRow* row,
+                              const EditorSyntax* syntax,
+                              bool in_comment) {
+    if (!cache->buckets)
+        return 0;
+
+    uint32_t index = *hlCacheBucket(cache, hash);
+    while (index) {
+        const EditorHLEntry* entry = &cache->entries.data[index];
+        if (entry->hash == hash && entry->row_size == (uint32_t)row->size &&
+            entry->syntax == syntax && entry->in_comment == in_comment &&
+            (row->size == 0 ||
+             memcmp(&cache->pool.data[entry->offset + entry->size], row->data,
+                    row->size) == 0)) {
+            return index;
+        }
+        index = entry->hash_next;
+    }
+    return 0;
+}
 
-            // Multi-line comment
-            if (mcs_len && mce_len) {
-                int start = i;
-                if (!in_comment && i + mcs_len <= row->size &&
-                    strncmp(&row->data[i], mcs, mcs_len) == 0) {
-                    i += mcs_len;
-                    in_comment = true;
-                }
+static void hlCacheUnhash(EditorHLCache* cache, uint32_t index) {
+    EditorHLEntry* entry = &cache->entries.data[index];
+    uint32_t* link = hlCacheBucket(cache, entry->hash);
+    while (*link) {
+        if (*link == index) {
+            *link = entry->hash_next;
+            break;
+        }
+        link = &cache->entries.data[*link].hash_next;
+    }
+    entry->hash_next = 0;
+}
 
-                if (in_comment) {
-                    while (i < row->size) {
-                        if (i + mce_len <= row->size &&
-                            strncmp(&row->data[i], mce, mce_len) == 0) {
-                            i += mce_len;
-                            in_comment = false;
-                            prev_sep = true;
-                            break;
-                        }
-                        i++;
-                    }
+// Make room for n more bytes, compacting the live spans first.
+static void editorHLPoolReserve(EditorHLCache* cache, uint32_t n) {
+    if (cache->pool.size + n <= cache->pool.capacity)
+        return;
 
-                    if (i > row->size)
-                        i = row->size;
+    uint32_t live = n;
+    for (uint32_t i = 1; i < cache->entries.size; i++) {
+        live += cache->entries.data[i].size + cache->entries.data[i].row_size;
+    }
 
-                    vector_push(row->hl_spans, (EditorHLSpan){
-                                                   .start = start,
-                                                   .len = i - start,
-                                                   .type = HL_COMMENT,
-                                               });
-                    continue;
-                }
+    uint32_t capacity = live * 2;
+    if (capacity < 256)
+        capacity = 256;
+
+    uint8_t* data = malloc_s(capacity);
+    uint32_t size = 0;
+    for (uint32_t i = 1; i < cache->entries.size; i++) {
+        EditorHLEntry* entry = &cache->entries.data[i];
+        uint32_t entry_size = entry->size + entry->row_size;
+        if (entry_size) {
+            memcpy(&data[size], &cache->pool.data[entry->offset], entry_size);
+        }
+        entry->offset = size;
+        size += entry_size;
+    }
+
+    free(cache->pool.data);
+    cache->pool.data = data;
+    cache->pool.size = size;
+    cache->pool.capacity = capacity;
+}
+
+// Store the scanned spans and the row content under a new entry, evicting
+// the least recently used one if the cache is full.
+static uint32_t hlCacheInsert(EditorHLCache* cache,
+                              const EditorHLEntry* key,
+                              const char* row_data) {
+    if (cache->entries.size == 0) {
+        // Sentinel
+        vector_push(cache->entries, (EditorHLEntry){0});
+        cache->buckets = calloc_s(HL_CACHE_BUCKETS, sizeof(uint32_t));
+    }
+
+    uint32_t index;
+    if (cache->entries.size <= HL_CACHE_MAX_ROWS) {
+        index = cache->entries.size;
+        vector_push(cache->entries, (EditorHLEntry){0});
+    } else {
+        index = cache->entries.data[0].prev;
+        hlCacheUnlink(cache, index);
+        hlCacheUnhash(cache, index);
+    }
+
+    EditorHLEntry* entry = &cache->entries.data[index];
+    uint32_t gen = entry->gen + 1;
+    uint32_t n = hl_scratch.size;
+    uint32_t total = n + key->row_size;
+    if (total > entry->size + entry->row_size) {
+        // Old bytes are left behind until the next compaction
+        entry->size = 0;
+        entry->row_size = 0;
+        editorHLPoolReserve(cache, total);
+        entry->offset = cache->pool.size;
+        cache->pool.size += total;
+    }
+    uint32_t offset = entry->offset;
+    if (n)
+        memcpy(&cache->pool.data[offset], hl_scratch.data, n);
+    if (key->row_size)
+        memcpy(&cache->pool.data[offset + n], row_data, key->row_size);
+
+    *entry = *key;
+    entry->gen = gen;
+    entry->offset = offset;
+    entry->size = n;
+
+    uint32_t* bucket = hlCacheBucket(cache, entry->hash);
+    entry->hash_next = *bucket;
+    *bucket = index;
+    hlCacheLinkFront(cache, index);
+
+    return index;
+}
+
+const EditorHLEntry* editorGetRowHL(EditorFile* file, EditorRow* row) {
+    if (!editorRowHasHL(file, row)) {
+        editorUpdateSyntax(file, row, HL_UPDATE_SINGLE_LINE);
+    } else if (file->hl_cache.entries.data[0].next != row->hl_entry) {
+        hlCacheUnlink(&file->hl_cache, row->hl_entry);
+        hlCacheLinkFront(&file->hl_cache, row->hl_entry);
+    }
+    return &file->hl_cache.entries.data[row->hl_entry];
+}
+
+void editorHLSpanIterInit(EditorHLSpanIter* it,
+                          const EditorFile* file,
+                          const EditorHLEntry* entry) {
+    it->p = entry->size ? &file->hl_cache.pool.data[entry->offset] : NULL;
+    it->end = it->p + entry->size;
+    it->pos = 0;
+}
+
+void editorClearHLCache(EditorHLCache* cache) {
+    // Keep the generations so no row handle can match again
+    for (uint32_t i = 1; i < cache->entries.size; i++) {
+        EditorHLEntry* entry = &cache->entries.data[i];
+        entry->gen++;
+        entry->size = 0;
+        entry->row_size = 0;
+        entry->syntax = NULL;
+        entry->hash_next = 0;
+    }
+    if (cache->buckets)
+        memset(cache->buckets, 0, HL_CACHE_BUCKETS * sizeof(uint32_t));
+    cache->pool.size = 0;
+}
+
+void editorFreeHLCache(EditorHLCache* cache) {
+    vector_free(cache->pool);
+    vector_free(cache->entries);
+    free(cache->buckets);
+    cache->buckets = NULL;
+}
+
+typedef struct HLContext {
+    const EditorSyntax* s;
+    const char* scs;
+    const char* mcs;
+    const char* mce;
+    int scs_len;
+    int mcs_len;
+    int mce_len;
+    bool skip_idents;
+} HLContext;
+
+static void editorInitHLContext(HLContext* ctx, const EditorSyntax* s) {
+    ctx->s = s;
+    ctx->scs = s->singleline_comment_start;
+    ctx->mcs = s->multiline_comment_start;
+    ctx->mce = s->multiline_comment_end;
+
+    ctx->scs_len = ctx->scs ? strlen(ctx->scs) : 0;
+    ctx->mcs_len = ctx->mcs ? strlen(ctx->mcs) : 0;
+    ctx->mce_len = ctx->mce ? strlen(ctx->mce) : 0;
+
+    // Identifier runs can be skipped as a whole unless a comment could start
+    // inside one.
+    ctx->skip_idents =
+        (!ctx->scs_len || !hl_ident_table[(uint8_t)ctx->scs[0]]) &&
+        (!ctx->mcs_len || !hl_ident_table[(uint8_t)ctx->mcs[0]]);
+}
+
+// Scan a row starting in the given comment state, emitting its spans unless
+// lazy. return: whether a multi-line comment is still open at the end
+static bool editorHLScanRow(const HLContext* ctx,
+                            const EditorRow* row,
+                            bool in_comment,
+                            bool lazy) {
+    const EditorSyntax* s = ctx->s;
+    const char* scs = ctx->scs;
+    const char* mcs = ctx->mcs;
+    const char* mce = ctx->mce;
+    const int scs_len = ctx->scs_len;
+    const int mcs_len = ctx->mcs_len;
+    const int mce_len = ctx->mce_len;
+    const bool skip_idents = ctx->skip_idents;
+
+    // TODO: support single-line comments/strings that end with '\' in C/C++
+    bool prev_sep = true;
+
+    int i = 0;
+    while (i < row->size) {
+        char c = row->data[i];
+
+        // Multi-line comment
+        if (mcs_len && mce_len) {
+            int start = i;
+            if (!in_comment && i + mcs_len <= row->size &&
+                strncmp(&row->data[i], mcs, mcs_len) == 0) {
+                i += mcs_len;
+                in_comment = true;
             }
 
-            if (lazy) {
-                i++;
+            if (in_comment) {
+                int end = hlFindStr(row->data, i, row->size, mce, mce_len);
+                if (end < 0) {
+                    i = row->size;
+                } else {
+                    i = end + mce_len;
+                    in_comment = false;
+                    prev_sep = true;
+                }
+
+                if (!lazy)
+                    hlEmitSpan(start, i - start, HL_COMMENT);
                 continue;
             }
+        }
 
-            // Single line comment
-            if (scs_len) {
-                if (i + scs_len <= row->size &&
-                    strncmp(&row->data[i], scs, scs_len) == 0) {
-                    // Mark entire line as comment
-                    vector_push(row->hl_spans, (EditorHLSpan){
-                                                   .start = i,
-                                                   .len = row->size - i,
-                                                   .type = HL_COMMENT,
-                                               });
-                    break;
-                }
+        if (lazy) {
+            // Only a comment start matters here
+            int next = -1;
+            if (mcs_len && mce_len)
+                next = hlFindStr(row->data, i + 1, row->size, mcs, mcs_len);
+            i = (next < 0) ? row->size : next;
+            continue;
+        }
+
+        // Single line comment
+        if (scs_len) {
+            if (i + scs_len <= row->size &&
+                strncmp(&row->data[i], scs, scs_len) == 0) {
+                // Mark entire line as comment
+                hlEmitSpan(i, row->size - i, HL_COMMENT);
+                break;
             }
+        }
 
-            // String
-            if (s->flags & HL_HIGHLIGHT_STRINGS) {
-                if (c == '"' || c == '\'') {
-                    int start = i;
-                    i++;
-                    while (i < row->size && row->data[i] != c) {
-                        if (row->data[i] == '\\') {
-                            i++;
-                        }
-                        i++;
+        // String
+        if (s->flags & HL_HIGHLIGHT_STRINGS) {
+            if (c == '"' || c == '\'') {
+                int start = i;
+                i++;
+                while (i < row->size) {
+                    int next =
+                        hlFindEither(row->data, i, row->size, c, '\\');
+                    if (next < 0) {
+                        i = row->size;
+                        break;
                     }
+                    i = next;
+                    if (row->data[i] == c)
+                        break;
+                    // Skip the escaped character
+                    i += 2;
+                }
 
-                    if (i < row->size && row->data[i] == c)
-                        i++;
-                    if (i > row->size)
-                        i = row->size;
+                if (i < row->size && row->data[i] == c)
+                    i++;
+                if (i > row->size)
+                    i = row->size;
 
-                    vector_push(row->hl_spans, (EditorHLSpan){
-                                                   .start = start,
-                                                   .len = i - start,
-                                                   .type = HL_STRING,
-                                               });
-                    prev_sep = true;
-                    continue;
-                }
+                hlEmitSpan(start, i - start, HL_STRING);
+                prev_sep = true;
+                continue;
             }
+        }
 
-            // Number
-            if (s->flags & HL_HIGHLIGHT_NUMBERS) {
-                // Try to keep this simple and general, not tied too closely to
-                // C/C++
-                if ((isDigit(c) || c == '.') && prev_sep) {
-                    int start = i;
-                    enum NumberParseState {
-                        NP_UNKNOWN,
-                        NP_ACCEPT,
-                        NP_REJECT,
-                    } state = NP_UNKNOWN;
-                    if (c == '0') {
-                        i++;
-                        if (i < row->size) {
-                            if (row->data[i] == 'b' || row->data[i] == 'B') {
-                                // Binary
+        // Number
+        if (s->flags & HL_HIGHLIGHT_NUMBERS) {
+            // Try to keep this simple and general, not tied too closely to
+            // C/C++
+            if ((isDigit(c) || c == '.') && prev_sep) {
+                int start = i;
+                enum NumberParseState {
+                    NP_UNKNOWN,
+                    NP_ACCEPT,
+                    NP_REJECT,
+                } state = NP_UNKNOWN;
+                if (c == '0') {
+                    i++;
+                    if (i < row->size) {
+                        if (row->data[i] == 'b' || row->data[i] == 'B') {
+                            // Binary
+                            i++;
+                            while (i < row->size && (row->data[i] == '0' ||
+                                                     row->data[i] == '1')) {
                                 i++;
-                                while (i < row->size && (row->data[i] == '0' ||
-                                                         row->data[i] == '1')) {
-                                    i++;
-                                }
-                                state = (i - start > 2) ? NP_ACCEPT : NP_REJECT;
-                            } else if (row->data[i] == 'x' ||
-                                       row->data[i] == 'X') {
-                                // Hex
+                            }
+                            state = (i - start > 2) ? NP_ACCEPT : NP_REJECT;
+                        } else if (row->data[i] == 'x' ||
+                                   row->data[i] == 'X') {
+                            // Hex
+                            i++;
+                            while (i < row->size &&
+                                   (isDigit(row->data[i]) ||
+                                    (row->data[i] >= 'a' &&
+                                     row->data[i] <= 'f') ||
+                                    (row->data[i] >= 'A' &&
+                                     row->data[i] <= 'F'))) {
+                                i++;
+                            }
+                            state = (i - start > 2) ? NP_ACCEPT : NP_REJECT;
+                        } else {
+                            // Oct
+                            while (i < row->size && row->data[i] >= '0' &&
+                                   row->data[i] <= '7') {
                                 i++;
-                                while (i < row->size &&
-                                       (isDigit(row->data[i]) ||
-                                        (row->data[i] >= 'a' &&
-                                         row->data[i] <= 'f') ||
-                                        (row->data[i] >= 'A' &&
-                                         row->data[i] <= 'F'))) {
-                                    i++;
-                                }
-                                state = (i - start > 2) ? NP_ACCEPT : NP_REJECT;
-                            } else {
-                                // Oct
-                                while (i < row->size && row->data[i] >= '0' &&
-                                       row->data[i] <= '7') {
-                                    i++;
-                                }
-
-                                if (i < row->size && row->data[i] != '.' &&
-                                    row->data[i] != 'e' &&
-                                    row->data[i] != 'E' &&
-                                    !isDigit(row->data[i])) {
-                                    // Make sure it's not a float
-                                    state = NP_ACCEPT;
-                                }
+                            }
+
+                            if (i < row->size && row->data[i] != '.' &&
+                                row->data[i] != 'e' &&
+                                row->data[i] != 'E' &&
+                                !isDigit(row->data[i])) {
+                                // Make sure it's not a float
+                                state = NP_ACCEPT;
                             }
                         }
                     }
+                }
 
-                    if (state == NP_UNKNOWN) {
-                        bool is_float = false;
-                        bool has_non_octal = false;
+                if (state == NP_UNKNOWN) {
+                    bool is_float = false;
+                    bool has_non_octal = false;
 
-                        i = start;
+                    i = start;
 
-                        // Float or decimal
-                        while (i < row->size && isDigit(row->data[i])) {
-                            if (c == '0' && i > start &&
-                                (row->data[i] == '8' || row->data[i] == '9')) {
-                                has_non_octal = true;
-                            }
-                            i++;
+                    // Float or decimal
+                    while (i < row->size && isDigit(row->data[i])) {
+                        if (c == '0' && i > start &&
+                            (row->data[i] == '8' || row->data[i] == '9')) {
+                            has_non_octal = true;
                         }
+                        i++;
+                    }
 
-                        if (i < row->size && (row->data[i] == '.')) {
-                            is_float = true;
+                    if (i < row->size && (row->data[i] == '.')) {
+                        is_float = true;
+                        i++;
+                        while (i < row->size && isDigit(row->data[i])) {
                             i++;
-                            while (i < row->size && isDigit(row->data[i])) {
-                                i++;
-                            }
                         }
+                    }
 
-                        if (c == '.' && i == start + 1) {
-                            // Reject only '.'
-                            state = NP_REJECT;
-                        }
+                    if (c == '.' && i == start + 1) {
+                        // Reject only '.'
+                        state = NP_REJECT;
+                    }
 
-                        if (state == NP_UNKNOWN && i < row->size &&
-                            (row->data[i] == 'e' || row->data[i] == 'E')) {
-                            is_float = true;
+                    if (state == NP_UNKNOWN && i < row->size &&
+                        (row->data[i] == 'e' || row->data[i] == 'E')) {
+                        is_float = true;
+                        i++;
+                        if (i < row->size &&
+                            (row->data[i] == '+' || row->data[i] == '-')) {
                             i++;
-                            if (i < row->size &&
-                                (row->data[i] == '+' || row->data[i] == '-')) {
+                        }
+                        if (!(i < row->size && isDigit(row->data[i]))) {
+                            state = NP_REJECT;
+                        } else {
+                            // Keep the state as NP_UNKNOWN to add suffixes
+                            // later
+                            while (i < row->size && isDigit(row->data[i])) {
                                 i++;
                             }
-                            if (!(i < row->size && isDigit(row->data[i]))) {
-                                state = NP_REJECT;
-                            } else {
-                                // Keep the state as NP_UNKNOWN to add suffixes
-                                // later
-                                while (i < row->size && isDigit(row->data[i])) {
-                                    i++;
-                                }
-                            }
                         }
+                    }
 
-                        // Reject invalid octal integers that aren't floats
-                        if (state == NP_UNKNOWN && c == '0' && has_non_octal &&
-                            !is_float) {
-                            state = NP_REJECT;
-                        }
+                    // Reject invalid octal integers that aren't floats
+                    if (state == NP_UNKNOWN && c == '0' && has_non_octal &&
+                        !is_float) {
+                        state = NP_REJECT;
+                    }
 
-                        // We only allow float suffixes since they are common
-                        if (state == NP_UNKNOWN && is_float && i < row->size &&
-                            (row->data[i] == 'f' || row->data[i] == 'F')) {
-                            i++;
-                        }
+                    // We only allow float suffixes since they are common
+                    if (state == NP_UNKNOWN && is_float && i < row->size &&
+                        (row->data[i] == 'f' || row->data[i] == 'F')) {
+                        i++;
+                    }
 
-                        if (state == NP_UNKNOWN) {
-                            state = NP_ACCEPT;
-                        }
+                    if (state == NP_UNKNOWN) {
+                        state = NP_ACCEPT;
                     }
+                }
 
-                    if (i > row->size)
-                        i = row->size;
+                if (i > row->size)
+                    i = row->size;
 
-                    if (state == NP_ACCEPT &&
-                        (i == row->size || isSeparator(row->data[i]) ||
-                         isSpace(row->data[i]))) {
-                        vector_push(row->hl_spans, (EditorHLSpan){
-                                                       .start = start,
-                                                       .len = i - start,
-                                                       .type = HL_NUMBER,
-                                                   });
-                    }
-                    prev_sep = false;
-                    continue;
+                if (state == NP_ACCEPT &&
+                    (i == row->size || isSeparator(row->data[i]) ||
+                     isSpace(row->data[i]))) {
+                    hlEmitSpan(start, i - start, HL_NUMBER);
                 }
+                prev_sep = false;
+                continue;
             }
+        }
 
-            // Keyword
-            if (prev_sep) {
-                bool found_keyword = false;
-                for (int kw = 0; kw < 3; kw++) {
-                    for (size_t j = 0; j < s->keywords[kw].size; j++) {
-                        int klen = strlen(s->keywords[kw].data[j]);
-                        EditorHLType keyword_type = HL_KEYWORD1 + kw;
-                        if (klen <= row->size - i &&
-                            strncmp(&row->data[i], s->keywords[kw].data[j],
-                                    klen) == 0 &&
-                            (i + klen == row->size ||
-                             isNonIdentifierChar(row->data[i + klen]))) {
-                            found_keyword = true;
-                            vector_push(row->hl_spans, (EditorHLSpan){
-                                                           .start = i,
-                                                           .len = klen,
-                                                           .type = keyword_type,
-                                                       });
-                            i += klen;
-                            break;
-                        }
-                    }
-                    if (found_keyword) {
+        // Keyword
+        if (prev_sep) {
+            bool found_keyword = false;
+            for (int kw = 0; kw < 3; kw++) {
+                for (size_t j = 0; j < s->keywords[kw].size; j++) {
+                    int klen = strlen(s->keywords[kw].data[j]);
+                    EditorHLType keyword_type = HL_KEYWORD1 + kw;
+                    if (klen <= row->size - i &&
+                        strncmp(&row->data[i], s->keywords[kw].data[j],
+                                klen) == 0 &&
+                        (i + klen == row->size ||
+                         isNonIdentifierChar(row->data[i + klen]))) {
+                        found_keyword = true;
+                        hlEmitSpan(i, klen, keyword_type);
+                        i += klen;
                         break;
                     }
                 }
-
                 if (found_keyword) {
-                    prev_sep = false;
-                    continue;
+                    break;
                 }
             }
-            prev_sep = !!isNonIdentifierChar(c);
-            i++;
+
+            if (found_keyword) {
+                prev_sep = false;
+                continue;
+            }
+        }
+        prev_sep = !!isNonIdentifierChar(c);
+        i++;
+
+        if (!prev_sep && skip_idents) {
+            while (i < row->size && hl_ident_table[(uint8_t)row->data[i]])
+                i++;
+        }
+    }
+
+    return in_comment;
+}
+
+// Full highlight of a row, shared with every row of the same content and
+// incoming state. ctx is NULL when highlighting is off.
+// return: whether a multi-line comment is still open at the end
+static bool editorRowHighlight(EditorFile* file,
+                               const HLContext* ctx,
+                               EditorRow* row,
+                               bool in_comment) {
+    EditorHLCache* cache = &file->hl_cache;
+    const EditorSyntax* s = ctx ? ctx->s : NULL;
+    uint64_t hash = hashBytes(row->data, row->size, 0);
+
+    uint32_t index = hlCacheLookup(cache, hash, row, s, in_comment);
+    if (index) {
+        if (cache->entries.data[0].next != index) {
+            hlCacheUnlink(cache, index);
+            hlCacheLinkFront(cache, index);
+        }
+    } else {
+        vector_clear(hl_scratch);
+        hl_scratch_pos = 0;
+
+        bool out_comment = false;
+        if (ctx)
+            out_comment = editorHLScanRow(ctx, row, in_comment, false);
+
+        EditorHLEntry key = {
+            .hash = hash,
+            .row_size = row->size,
+            .syntax = s,
+            .in_comment = in_comment,
+            .out_comment = out_comment,
+            .trailing_spaces = editorRowCountTrailingSpaces(row),
+        };
+        index = hlCacheInsert(cache, &key, row->data);
+    }
+
+    row->hl_entry = index;
+    row->hl_gen = cache->entries.data[index].gen;
+    return cache->entries.data[index].out_comment;
+}
+
+static int editorUpdateSyntaxRows(EditorFile* file,
+                                  EditorRow* r,
+                                  int count,
+                                  int flags) {
+    const EditorSyntax* s = file->syntax;
+
+    bool lazy = flags & HL_UPDATE_LAZY;
+    bool single_line = flags & HL_UPDATE_SINGLE_LINE;
+
+    if (!syntax.int_value || !s) {
+        for (int i = 0; i < count; i++) {
+            if (lazy) {
+                r[i].hl_gen = 0;
+            } else {
+                editorRowHighlight(file, NULL, &r[i], false);
+            }
+        }
+        return count;
+    }
+
+    HLContext ctx;
+    editorInitHLContext(&ctx, s);
+
+    bool do_next_row = true;
+    int row_index = (int)(r - file->row);
+
+    int processed_rows = 0;
+
+    while ((do_next_row || processed_rows < count) &&
+           row_index < file->num_rows) {
+        EditorRow* row = &file->row[row_index];
+
+        do_next_row = false;
+
+        bool in_comment =
+            (row_index > 0 && file->row[row_index - 1].hl_open_comment);
+        if (lazy) {
+            in_comment = editorHLScanRow(&ctx, row, in_comment, true);
+            // Spans have to be looked up again
+            row->hl_gen = 0;
+        } else {
+            in_comment = editorRowHighlight(file, &ctx, row, in_comment);
         }
 
         bool changed = (row->hl_open_comment != in_comment);
@@ -321,7 +684,7 @@ int editorUpdateSyntax(EditorFile* file, EditorRow* r, int flags) {
         row_index++;
         processed_rows++;
 
-        if (single_line) {
+        if (single_line && processed_rows >= count) {
             break;
         }
     }
@@ -329,7 +692,129 @@ int editorUpdateSyntax(EditorFile* file, EditorRow* r, int flags) {
     return processed_rows;
 }
 
+int editorUpdateSyntax(EditorFile* file, EditorRow* row, int flags) {
+    return editorUpdateSyntaxRange(file, row, 1, flags);
+}
+
+int editorUpdateSyntaxRange(EditorFile* file,
+                            EditorRow* row,
+                            int count,
+                            int flags) {
+    EditorPerfPhase phase = editorPerfEnter(PERF_HIGHLIGHT);
+    int updated = editorUpdateSyntaxRows(file, row, count, flags);
+    editorPerfLeave(phase);
+    return updated;
+}
+
+// Full reloads of large files are split into chunks scanned on their own
+// threads. A chunk doesn't know if it starts inside a comment, so it is
+// scanned both ways and the right result is picked afterwards.
+#define HL_CHUNK_MIN_ROWS (1 << 14)
+#define HL_MAX_THREADS 64
+
+typedef struct HLChunk {
+    const HLContext* ctx;
+    EditorRow* rows;
+    int start;
+    int end;
+    bool scan_open;
+    // Number of leading rows whose state flips when the chunk starts inside
+    // a comment. Later rows end up the same either way.
+    int diverged;
+    Thread thread;
+} HLChunk;
+
+static void editorHLScanChunk(void* arg) {
+    HLChunk* chunk = arg;
+    EditorRow* rows = chunk->rows;
+
+    bool in_comment = false;
+    for (int i = chunk->start; i < chunk->end; i++) {
+        in_comment = editorHLScanRow(chunk->ctx, &rows[i], in_comment, true);
+        rows[i].hl_open_comment = in_comment;
+        rows[i].hl_gen = 0;
+    }
+
+    chunk->diverged = 0;
+    if (!chunk->scan_open)
+        return;
+
+    in_comment = true;
+    for (int i = chunk->start; i < chunk->end; i++) {
+        in_comment = editorHLScanRow(chunk->ctx, &rows[i], in_comment, true);
+        if (in_comment == rows[i].hl_open_comment)
+            break;
+        chunk->diverged++;
+    }
+}
+
+static bool editorFileReloadHighlightParallel(EditorFile* file) {
+    const EditorSyntax* s = file->syntax;
+    if (!syntax.int_value || !s)
+        return false;
+
+    HLContext ctx;
+    editorInitHLContext(&ctx, s);
+    // Without multi-line comments every row starts in the same state
+    if (!ctx.mcs_len || !ctx.mce_len)
+        return false;
+
+    int threads = getCPUCount();
+    if (threads > HL_MAX_THREADS)
+        threads = HL_MAX_THREADS;
+    if (threads > file->num_rows / HL_CHUNK_MIN_ROWS)
+        threads = file->num_rows / HL_CHUNK_MIN_ROWS;
+    if (threads < 2)
+        return false;
+
+    HLChunk chunks[HL_MAX_THREADS];
+    int chunk_rows = (file->num_rows + threads - 1) / threads;
+    for (int i = 0; i < threads; i++) {
+        int start = i * chunk_rows;
+        int end = start + chunk_rows;
+        chunks[i] = (HLChunk){
+            .ctx = &ctx,
+            .rows = file->row,
+            .start = start,
+            .end = end < file->num_rows ? end : file->num_rows,
+            .scan_open = (i > 0),
+        };
+    }
+
+    // The first chunk runs here
+    bool started[HL_MAX_THREADS] = {false};
+    for (int i = 1; i < threads; i++) {
+        started[i] = threadCreate(&chunks[i].thread, editorHLScanChunk,
+                                  &chunks[i]);
+    }
+    editorHLScanChunk(&chunks[0]);
+    for (int i = 1; i < threads; i++) {
+        if (started[i]) {
+            threadJoin(&chunks[i].thread);
+        } else {
+            editorHLScanChunk(&chunks[i]);
+        }
+    }
+
+    bool in_comment = false;
+    for (int i = 0; i < threads; i++) {
+        if (in_comment) {
+            EditorRow* rows = file->row;
+            int end = chunks[i].start + chunks[i].diverged;
+            for (int j = chunks[i].start; j < end; j++) {
+                rows[j].hl_open_comment = !rows[j].hl_open_comment;
+            }
+        }
+        in_comment = file->row[chunks[i].end - 1].hl_open_comment;
+    }
+
+    return true;
+}
+
 void editorFileReloadHighlight(EditorFile* file) {
+    if (editorFileReloadHighlightParallel(file))
+        return;
+
     int i = 0;
     while (i < file->num_rows) {
         int count = editorUpdateSyntax(file, &file->row[i], HL_UPDATE_LAZY);
@@ -342,28 +827,148 @@ void editorFileReloadHighlight(EditorFile* file) {
     }
 }
 
+static void editorLoadSyntax(EditorSyntax* syntax_def);
+
 void editorSetSyntaxHighlight(EditorFile* file, EditorSyntax* syntax_def) {
+    if (syntax_def)
+        editorLoadSyntax(syntax_def);
     file->syntax = syntax_def;
     editorFileReloadHighlight(file);
 }
 
+// File type lookup. ".ext" entries go in a hash index, other entries are
+// substring patterns and stay in a list. rank is the position in the HLDB
+// list, lower wins like the order of a linear walk.
+typedef struct HLDBIndexSlot {
+    char* ext;  // Lower case, NULL if empty
+    EditorSyntax* syntax;
+    int rank;
+} HLDBIndexSlot;
+
+typedef struct HLDBPattern {
+    const char* pattern;
+    EditorSyntax* syntax;
+    int rank;
+} HLDBPattern;
+
+static struct {
+    const EditorSyntax* head;  // HLDB head the index was built for
+    HLDBIndexSlot* slots;
+    uint32_t capacity;
+    VECTOR(HLDBPattern) patterns;
+} hldb_index;
+
+static uint64_t hldbIndexHash(const char* ext, size_t len) {
+    char lower[EDITOR_PATH_MAX];
+    if (len > sizeof(lower))
+        len = sizeof(lower);
+    for (size_t i = 0; i < len; i++) {
+        lower[i] = toLower(ext[i]);
+    }
+    return hashBytes(lower, len, 0);
+}
+
+static void editorFreeHLDBIndex(void) {
+    for (uint32_t i = 0; i < hldb_index.capacity; i++) {
+        free(hldb_index.slots[i].ext);
+    }
+    free(hldb_index.slots);
+    vector_free(hldb_index.patterns);
+    hldb_index.slots = NULL;
+    hldb_index.capacity = 0;
+    hldb_index.head = NULL;
+}
+
+static void editorBuildHLDBIndex(void) {
+    editorFreeHLDBIndex();
+
+    uint32_t count = 0;
+    for (EditorSyntax* s = gEditor.HLDB; s; s = s->next) {
+        count += s->file_exts.size;
+    }
+
+    uint32_t capacity = 16;
+    while (capacity < count * 2) {
+        capacity *= 2;
+    }
+    hldb_index.slots = calloc_s(capacity, sizeof(HLDBIndexSlot));
+    hldb_index.capacity = capacity;
+    hldb_index.head = gEditor.HLDB;
+
+    int rank = 0;
+    for (EditorSyntax* s = gEditor.HLDB; s; s = s->next, rank++) {
+        for (size_t i = 0; i < s->file_exts.size; i++) {
+            const char* ext = s->file_exts.data[i];
+            if (ext[0] != '.') {
+                vector_push(hldb_index.patterns, (HLDBPattern){
+                                                     .pattern = ext,
+                                                     .syntax = s,
+                                                     .rank = rank,
+                                                 });
+                continue;
+            }
+
+            size_t len = strlen(ext);
+            uint32_t slot = hldbIndexHash(ext, len) & (capacity - 1);
+            while (hldb_index.slots[slot].ext &&
+                   strCaseCmp(hldb_index.slots[slot].ext, ext) != 0) {
+                slot = (slot + 1) & (capacity - 1);
+            }
+
+            // Keep the earlier definition
+            if (hldb_index.slots[slot].ext)
+                continue;
+
+            char* key = malloc_s(len + 1);
+            for (size_t j = 0; j <= len; j++) {
+                key[j] = toLower(ext[j]);
+            }
+            hldb_index.slots[slot] = (HLDBIndexSlot){
+                .ext = key,
+                .syntax = s,
+                .rank = rank,
+            };
+        }
+    }
+}
+
 void editorSelectSyntaxHighlight(EditorFile* file) {
     file->syntax = NULL;
     if (file->filename == NULL)
         return;
 
-    char* ext = strrchr(file->filename, '.');
-
-    for (EditorSyntax* s = gEditor.HLDB; s; s = s->next) {
-        for (size_t i = 0; i < s->file_exts.size; i++) {
-            int is_ext = (s->file_exts.data[i][0] == '.');
-            if ((is_ext && ext && strCaseCmp(ext, s->file_exts.data[i]) == 0) ||
-                (!is_ext && strCaseStr(file->filename, s->file_exts.data[i]))) {
-                editorSetSyntaxHighlight(file, s);
-                return;
+    if (!hldb_index.slots || hldb_index.head != gEditor.HLDB)
+        editorBuildHLDBIndex();
+
+    EditorSyntax* match = NULL;
+    int match_rank = 0;
+
+    const char* ext = strrchr(file->filename, '.');
+    if (ext) {
+        uint32_t mask = hldb_index.capacity - 1;
+        uint32_t slot = hldbIndexHash(ext, strlen(ext)) & mask;
+        while (hldb_index.slots[slot].ext) {
+            if (strCaseCmp(hldb_index.slots[slot].ext, ext) == 0) {
+                match = hldb_index.slots[slot].syntax;
+                match_rank = hldb_index.slots[slot].rank;
+                break;
             }
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    for (size_t i = 0; i < hldb_index.patterns.size; i++) {
+        const HLDBPattern* p = &hldb_index.patterns.data[i];
+        if (match && p->rank >= match_rank)
+            break;
+        if (strCaseStr(file->filename, p->pattern)) {
+            match = p->syntax;
+            break;
         }
     }
+
+    if (match)
+        editorSetSyntaxHighlight(file, match);
 }
 
 #define ARENA_SIZE (1 << 12)
@@ -373,16 +978,64 @@ static JsonArena hldb_arena;
 static void loadEditorConfigHLDB(void);
 static void editorLoadBundledHLDB(void);
 
+typedef struct HLDBSource {
+    char* path;
+    int64_t mtime;
+    uint64_t size;
+} HLDBSource;
+
+typedef VECTOR(HLDBSource) HLDBSourceVector;
+
+static void editorCollectHLDBSources(const char* home_dir,
+                                     HLDBSourceVector* sources);
+static uint64_t editorBundleHash(void);
+static bool editorLoadHLDBCache(const char* path,
+                                const HLDBSourceVector* sources,
+                                uint64_t bundle_hash);
+static void editorWriteHLDBCache(const char* path,
+                                 const HLDBSourceVector* sources,
+                                 uint64_t bundle_hash,
+                                 const EditorSyntax* end);
+
 void editorInitHLDB(void) {
     json_arena_init(&hldb_arena, ARENA_SIZE);
+    editorInitIdentTable();
 
     loadEditorConfigHLDB();
-    editorLoadBundledHLDB();
+    const EditorSyntax* config_syntax = gEditor.HLDB;
+
+    HLDBSourceVector sources = {0};
+    char cache_path[EDITOR_PATH_MAX] = {0};
 
     const char* home_dir = getEnv(ENV_HOME);
-    if (!home_dir)
-        return;
+    if (home_dir) {
+        snprintf(cache_path, sizeof(cache_path),
+                 PATH_CAT("%s", CONF_DIR, HLDB_CACHE_FILE), home_dir);
+        editorCollectHLDBSources(home_dir, &sources);
+    }
 
+    uint64_t bundle_hash = editorBundleHash();
+    if (!home_dir ||
+        !editorLoadHLDBCache(cache_path, &sources, bundle_hash)) {
+        editorLoadBundledHLDB();
+        for (size_t i = 0; i < sources.size; i++) {
+            editorLoadHLDB(sources.data[i].path);
+        }
+
+        if (home_dir) {
+            editorWriteHLDBCache(cache_path, &sources, bundle_hash,
+                                 config_syntax);
+        }
+    }
+
+    for (size_t i = 0; i < sources.size; i++) {
+        free(sources.data[i].path);
+    }
+    vector_free(sources);
+}
+
+static void editorCollectHLDBSources(const char* home_dir,
+                                     HLDBSourceVector* sources) {
     char path[EDITOR_PATH_MAX];
     snprintf(path, sizeof(path), PATH_CAT("%s", CONF_DIR, "syntax"), home_dir);
 
@@ -403,7 +1056,16 @@ void editorInitHLDB(void) {
         if (getFileType(file_path) == FT_REG) {
             const char* ext = strrchr(filename, '.');
             if (ext && strcmp(ext, ".json") == 0) {
-                editorLoadHLDB(file_path);
+                FileInfo info = getFileInfo(file_path);
+                if (info.error)
+                    continue;
+
+                HLDBSource source;
+                source.path = malloc_s(len + 1);
+                memcpy(source.path, file_path, len + 1);
+                source.mtime = getFileInfoMtime(info);
+                source.size = getFileInfoSize(info);
+                vector_push(*sources, source);
             }
         }
     } while (dirNext(&iter));
@@ -440,6 +1102,23 @@ static void loadEditorConfigHLDB(void) {
     gEditor.HLDB = syntax_def;
 }
 
+static const char* const kw_fields[] = {"keywords1", "keywords2", "keywords3"};
+
+// Keyword list i of a JSON definition, NULL if missing or any item is not a
+// non-empty string
+static const JsonArray* hldbJsonKeywords(const JsonValue* value, int i) {
+    const JsonValue* keywords = json_object_find(value->object, kw_fields[i]);
+    if (!keywords || keywords->type != JSON_ARRAY)
+        return NULL;
+
+    for (size_t j = 0; j < keywords->array->size; j++) {
+        const JsonValue* item = keywords->array->data[j];
+        if (item->type != JSON_STRING || *item->string == '\0')
+            return NULL;
+    }
+    return keywords->array;
+}
+
 static bool editorLoadJsonHLDB(const char* json, EditorSyntax* syntax_def) {
     // Parse json
     JsonValue* value = json_parse(json, &hldb_arena);
@@ -497,20 +1176,12 @@ static bool editorLoadJsonHLDB(const char* json, EditorSyntax* syntax_def) {
         syntax_def->multiline_comment_start = NULL;
         syntax_def->multiline_comment_end = NULL;
     }
-    const char* kw_fields[] = {"keywords1", "keywords2", "keywords3"};
-
+    // Keywords are read on first use
     for (int i = 0; i < 3; i++) {
         JsonValue* keywords = json_object_find(object, kw_fields[i]);
-        if (keywords) {
-            CHECK(keywords->type == JSON_ARRAY);
-            for (size_t j = 0; j < keywords->array->size; j++) {
-                JsonValue* item = keywords->array->data[j];
-                CHECK(item->type == JSON_STRING && *item->string != '\0');
-                vector_push(syntax_def->keywords[i], item->string);
-            }
-        }
-        vector_shrink(syntax_def->keywords[i]);
+        CHECK(!keywords || keywords->type == JSON_ARRAY);
     }
+    syntax_def->value = value;
 
 #undef CHECK
 
@@ -569,6 +1240,341 @@ bool editorLoadHLDB(const char* path) {
     return true;
 }
 
+// Compiled HLDB cache
+// Layout: header, sources, syntaxes, string offset arrays, strings. Offsets
+// are from the start of the file and 0 means none.
+
+#define HLDB_CACHE_MAGIC "NINOHLDB"
+#define HLDB_CACHE_VERSION 1
+#define HLDB_CACHE_BYTE_ORDER 0x01020304
+
+typedef struct HLDBCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t bundle_hash;
+    uint32_t size;
+    uint32_t source_count;
+    uint32_t syntax_count;
+    uint32_t reserved;
+} HLDBCacheHeader;
+
+typedef struct HLDBCacheSource {
+    uint32_t path;
+    uint32_t reserved;
+    int64_t mtime;
+    uint64_t size;
+} HLDBCacheSource;
+
+typedef struct HLDBCacheSyntax {
+    uint32_t file_type;
+    uint32_t singleline_comment_start;
+    uint32_t multiline_comment_start;
+    uint32_t multiline_comment_end;
+    uint32_t flags;
+    uint32_t exts;
+    uint32_t exts_count;
+    uint32_t keywords[3];
+    uint32_t keywords_count[3];
+} HLDBCacheSyntax;
+
+static const uint8_t* hldb_cache;
+static size_t hldb_cache_size;
+
+static uint64_t editorBundleHash(void) {
+    uint64_t hash = HLDB_CACHE_VERSION;
+    for (size_t i = 0; i < sizeof(bundle) / sizeof(bundle[0]); i++) {
+        hash = hashBytes(bundle[i], strlen(bundle[i]), hash);
+    }
+    return hash;
+}
+
+static inline bool hldbCacheValidString(uint32_t offset) {
+    return offset < hldb_cache_size;
+}
+
+static bool hldbCacheValidArray(uint32_t offset, uint32_t count) {
+    if ((uint64_t)offset + (uint64_t)count * sizeof(uint32_t) >
+        hldb_cache_size)
+        return false;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t item;
+        memcpy(&item, &hldb_cache[offset + i * sizeof(uint32_t)],
+               sizeof(item));
+        if (!item || !hldbCacheValidString(item))
+            return false;
+    }
+    return true;
+}
+
+static inline const char* hldbCacheString(uint32_t offset) {
+    return offset ? (const char*)&hldb_cache[offset] : NULL;
+}
+
+static void hldbCacheReadArray(uint32_t offset, uint32_t count, _Vector* vec) {
+    if (!count)
+        return;
+
+    const char** items = malloc_s(sizeof(const char*) * count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t item;
+        memcpy(&item, &hldb_cache[offset + i * sizeof(uint32_t)],
+               sizeof(item));
+        items[i] = hldbCacheString(item);
+    }
+    vec->data = items;
+    vec->size = count;
+    vec->capacity = count;
+}
+
+// Read the keywords of a definition the first time it's used. An invalid
+// keyword list is left empty.
+static void editorLoadSyntax(EditorSyntax* syntax_def) {
+    if (syntax_def->value) {
+        for (int i = 0; i < 3; i++) {
+            const JsonArray* keywords = hldbJsonKeywords(syntax_def->value, i);
+            if (!keywords)
+                continue;
+            for (size_t j = 0; j < keywords->size; j++) {
+                vector_push(syntax_def->keywords[i],
+                            keywords->data[j]->string);
+            }
+            vector_shrink(syntax_def->keywords[i]);
+        }
+        syntax_def->value = NULL;
+    }
+
+    const HLDBCacheSyntax* syntax = syntax_def->lazy;
+    if (syntax) {
+        for (int i = 0; i < 3; i++) {
+            if (hldbCacheValidArray(syntax->keywords[i],
+                                    syntax->keywords_count[i])) {
+                hldbCacheReadArray(syntax->keywords[i],
+                                   syntax->keywords_count[i],
+                                   (_Vector*)&syntax_def->keywords[i]);
+            }
+        }
+        syntax_def->lazy = NULL;
+    }
+}
+
+static bool editorLoadHLDBCache(const char* path,
+                                const HLDBSourceVector* sources,
+                                uint64_t bundle_hash) {
+    hldb_cache = mapFile(path, &hldb_cache_size);
+    if (!hldb_cache)
+        return false;
+
+    const HLDBCacheHeader* header = (const HLDBCacheHeader*)hldb_cache;
+    if (hldb_cache_size < sizeof(HLDBCacheHeader) ||
+        memcmp(header->magic, HLDB_CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != HLDB_CACHE_VERSION ||
+        header->byte_order != HLDB_CACHE_BYTE_ORDER ||
+        header->size != hldb_cache_size ||
+        header->bundle_hash != bundle_hash ||
+        header->source_count != sources->size ||
+        hldb_cache[hldb_cache_size - 1] != '\0')
+        goto errdefer;
+
+    if (sizeof(HLDBCacheHeader) +
+            (uint64_t)header->source_count * sizeof(HLDBCacheSource) +
+            (uint64_t)header->syntax_count * sizeof(HLDBCacheSyntax) >
+        hldb_cache_size)
+        goto errdefer;
+
+    // Any change to the source files invalidates the cache
+    const HLDBCacheSource* cache_sources =
+        (const HLDBCacheSource*)&hldb_cache[sizeof(HLDBCacheHeader)];
+    for (uint32_t i = 0; i < header->source_count; i++) {
+        const HLDBCacheSource* source = &cache_sources[i];
+        if (!source->path || !hldbCacheValidString(source->path) ||
+            strcmp(hldbCacheString(source->path), sources->data[i].path) !=
+                0 ||
+            source->mtime != sources->data[i].mtime ||
+            source->size != sources->data[i].size)
+            goto errdefer;
+    }
+
+    const HLDBCacheSyntax* syntaxes =
+        (const HLDBCacheSyntax*)&cache_sources[header->source_count];
+    for (uint32_t i = 0; i < header->syntax_count; i++) {
+        const HLDBCacheSyntax* syntax = &syntaxes[i];
+        if (!syntax->file_type || !hldbCacheValidString(syntax->file_type) ||
+            !hldbCacheValidString(syntax->singleline_comment_start) ||
+            !hldbCacheValidString(syntax->multiline_comment_start) ||
+            !hldbCacheValidString(syntax->multiline_comment_end) ||
+            !hldbCacheValidArray(syntax->exts, syntax->exts_count))
+            goto errdefer;
+    }
+
+    // Stored in list order
+    for (uint32_t i = header->syntax_count; i-- > 0;) {
+        const HLDBCacheSyntax* syntax = &syntaxes[i];
+        EditorSyntax* syntax_def = calloc_s(1, sizeof(EditorSyntax));
+
+        syntax_def->file_type = hldbCacheString(syntax->file_type);
+        syntax_def->singleline_comment_start =
+            hldbCacheString(syntax->singleline_comment_start);
+        syntax_def->multiline_comment_start =
+            hldbCacheString(syntax->multiline_comment_start);
+        syntax_def->multiline_comment_end =
+            hldbCacheString(syntax->multiline_comment_end);
+        syntax_def->flags = syntax->flags;
+
+        hldbCacheReadArray(syntax->exts, syntax->exts_count,
+                           (_Vector*)&syntax_def->file_exts);
+        // Keywords are read on first use
+        syntax_def->lazy = syntax;
+
+        syntax_def->next = gEditor.HLDB;
+        gEditor.HLDB = syntax_def;
+    }
+
+    return true;
+
+errdefer:
+    unmapFile((void*)hldb_cache, hldb_cache_size);
+    hldb_cache = NULL;
+    hldb_cache_size = 0;
+    return false;
+}
+
+static uint32_t hldbCacheAddString(abuf* strings,
+                                   uint32_t base,
+                                   const char* s) {
+    if (!s)
+        return 0;
+    uint32_t offset = base + strings->len;
+    abufAppendN(strings, s, strlen(s) + 1);
+    return offset;
+}
+
+static uint32_t hldbCacheAddArray(abuf* arrays,
+                                  uint32_t arrays_base,
+                                  abuf* strings,
+                                  uint32_t strings_base,
+                                  const char** items,
+                                  uint32_t count) {
+    uint32_t offset = arrays_base + arrays->len;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t item = hldbCacheAddString(strings, strings_base, items[i]);
+        abufAppendN(arrays, (const char*)&item, sizeof(item));
+    }
+    return offset;
+}
+
+// Keywords not loaded yet are taken from the JSON
+static uint32_t hldbKeywordCount(const EditorSyntax* s, int i) {
+    if (!s->value)
+        return s->keywords[i].size;
+    const JsonArray* keywords = hldbJsonKeywords(s->value, i);
+    return keywords ? keywords->size : 0;
+}
+
+static uint32_t hldbCacheAddKeywords(abuf* arrays,
+                                     uint32_t arrays_base,
+                                     abuf* strings,
+                                     uint32_t strings_base,
+                                     const EditorSyntax* s,
+                                     int i) {
+    if (!s->value) {
+        return hldbCacheAddArray(arrays, arrays_base, strings, strings_base,
+                                 s->keywords[i].data, s->keywords[i].size);
+    }
+
+    uint32_t offset = arrays_base + arrays->len;
+    const JsonArray* keywords = hldbJsonKeywords(s->value, i);
+    for (size_t j = 0; keywords && j < keywords->size; j++) {
+        uint32_t item = hldbCacheAddString(strings, strings_base,
+                                           keywords->data[j]->string);
+        abufAppendN(arrays, (const char*)&item, sizeof(item));
+    }
+    return offset;
+}
+
+// Write the definitions from the list head up to end (exclusive).
+static void editorWriteHLDBCache(const char* path,
+                                 const HLDBSourceVector* sources,
+                                 uint64_t bundle_hash,
+                                 const EditorSyntax* end) {
+    uint32_t syntax_count = 0;
+    uint32_t item_count = 0;
+    for (const EditorSyntax* s = gEditor.HLDB; s != end; s = s->next) {
+        syntax_count++;
+        item_count += s->file_exts.size;
+        for (int i = 0; i < 3; i++) {
+            item_count += hldbKeywordCount(s, i);
+        }
+    }
+
+    uint32_t arrays_base = sizeof(HLDBCacheHeader) +
+                           sources->size * sizeof(HLDBCacheSource) +
+                           syntax_count * sizeof(HLDBCacheSyntax);
+    uint32_t strings_base = arrays_base + item_count * sizeof(uint32_t);
+
+    abuf body = ABUF_INIT;
+    abuf arrays = ABUF_INIT;
+    abuf strings = ABUF_INIT;
+
+    for (size_t i = 0; i < sources->size; i++) {
+        HLDBCacheSource source = {
+            .path = hldbCacheAddString(&strings, strings_base,
+                                       sources->data[i].path),
+            .mtime = sources->data[i].mtime,
+            .size = sources->data[i].size,
+        };
+        abufAppendN(&body, (const char*)&source, sizeof(source));
+    }
+
+    for (const EditorSyntax* s = gEditor.HLDB; s != end; s = s->next) {
+        HLDBCacheSyntax syntax = {
+            .file_type = hldbCacheAddString(&strings, strings_base,
+                                            s->file_type),
+            .singleline_comment_start = hldbCacheAddString(
+                &strings, strings_base, s->singleline_comment_start),
+            .multiline_comment_start = hldbCacheAddString(
+                &strings, strings_base, s->multiline_comment_start),
+            .multiline_comment_end = hldbCacheAddString(
+                &strings, strings_base, s->multiline_comment_end),
+            .flags = s->flags,
+        };
+        syntax.exts_count = s->file_exts.size;
+        syntax.exts =
+            hldbCacheAddArray(&arrays, arrays_base, &strings, strings_base,
+                              s->file_exts.data, s->file_exts.size);
+        for (int i = 0; i < 3; i++) {
+            syntax.keywords_count[i] = hldbKeywordCount(s, i);
+            syntax.keywords[i] = hldbCacheAddKeywords(
+                &arrays, arrays_base, &strings, strings_base, s, i);
+        }
+        abufAppendN(&body, (const char*)&syntax, sizeof(syntax));
+    }
+
+    HLDBCacheHeader header = {
+        .version = HLDB_CACHE_VERSION,
+        .byte_order = HLDB_CACHE_BYTE_ORDER,
+        .bundle_hash = bundle_hash,
+        .size = strings_base + strings.len,
+        .source_count = sources->size,
+        .syntax_count = syntax_count,
+    };
+    memcpy(header.magic, HLDB_CACHE_MAGIC, sizeof(header.magic));
+
+    abuf out = ABUF_INIT;
+    abufAppendN(&out, (const char*)&header, sizeof(header));
+    abufAppendN(&out, body.buf, body.len);
+    abufAppendN(&out, arrays.buf, arrays.len);
+    abufAppendN(&out, strings.buf, strings.len);
+
+    // Nothing to do if it fails, the definitions are just parsed again
+    saveFileReplace(path, out.buf, out.len);
+
+    abufFree(&out);
+    abufFree(&body);
+    abufFree(&arrays);
+    abufFree(&strings);
+}
+
 void editorFreeHLDB(void) {
     EditorSyntax* HLDB = gEditor.HLDB;
     while (HLDB) {
@@ -583,4 +1589,56 @@ void editorFreeHLDB(void) {
     }
     json_arena_deinit(&hldb_arena);
     gEditor.HLDB = NULL;
+    editorFreeHLDBIndex();
+
+    if (hldb_cache) {
+        unmapFile((void*)hldb_cache, hldb_cache_size);
+        hldb_cache = NULL;
+        hldb_cache_size = 0;
+    }
+
+    // Cached results refer to the old definitions
+    for (int i = 0; i < EDITOR_FILE_MAX_SLOT; i++) {
+        editorClearHLCache(&gEditor.files[i].hl_cache);
+    }
+    vector_free(hl_scratch);
+}
+
+void editorReloadHLDB(void) {
+    // The definitions are freed, so remember the languages by name
+    char* names[EDITOR_FILE_MAX_SLOT] = {0};
+    for (int i = 0; i < EDITOR_FILE_MAX_SLOT; i++) {
+        const EditorFile* file = &gEditor.files[i];
+        if (file->reference_count == 0 || !file->syntax)
+            continue;
+        size_t len = strlen(file->syntax->file_type);
+        names[i] = malloc_s(len + 1);
+        memcpy(names[i], file->syntax->file_type, len + 1);
+    }
+
+    editorFreeHLDB();
+    editorInitHLDB();
+
+    for (int i = 0; i < EDITOR_FILE_MAX_SLOT; i++) {
+        EditorFile* file = &gEditor.files[i];
+        if (file->reference_count == 0)
+            continue;
+
+        EditorSyntax* s = NULL;
+        if (names[i]) {
+            for (s = gEditor.HLDB; s; s = s->next) {
+                if (strcmp(s->file_type, names[i]) == 0)
+                    break;
+            }
+            free(names[i]);
+        }
+
+        if (s) {
+            editorSetSyntaxHighlight(file, s);
+        } else {
+            editorSelectSyntaxHighlight(file);
+            if (!file->syntax)
+                editorFileReloadHighlight(file);
+        }
+    }
 }
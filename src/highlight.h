@@ -5,6 +5,7 @@
 
 typedef struct EditorFile EditorFile;
 typedef struct EditorRow EditorRow;
+typedef struct EditorSyntax EditorSyntax;
 
 // Highlighting flags
 #define HL_HIGHLIGHT_NUMBERS (1 << 0)
@@ -14,6 +15,9 @@ typedef struct EditorRow EditorRow;
 #define HL_UPDATE_LAZY (1 << 0)
 #define HL_UPDATE_SINGLE_LINE (1 << 1)
 
+// Compiled HLDB cache in the config directory
+#define HLDB_CACHE_FILE "hldb.cache"
+
 typedef enum EditorHLType {
     HL_NORMAL = 0,
     HL_COMMENT,
@@ -30,7 +34,73 @@ typedef struct EditorHLSpan {
     EditorHLType type;
 } EditorHLSpan;
 
-typedef struct EditorSyntax {
+// Spans are packed as varint((gap << 4) | type) followed by varint(len),
+// where gap is the distance from the end of the previous span.
+#define HL_CACHE_MAX_ROWS 1024
+#define HL_CACHE_BUCKETS 2048  // Power of two
+
+// Highlight result of a row, shared by every row with the same key.
+typedef struct EditorHLEntry {
+    uint32_t gen;  // Bumped every time the entry is reused
+    uint32_t hash_next;
+
+    // Key
+    uint64_t hash;  // Row content
+    uint32_t row_size;
+    const EditorSyntax* syntax;  // NULL when highlighting is off
+    bool in_comment;
+
+    // Result
+    bool out_comment;
+    uint32_t trailing_spaces;
+    uint32_t offset;  // Packed spans in the pool, followed by the row content
+    uint32_t size;    // Of the spans
+
+    uint32_t prev;  // LRU list
+    uint32_t next;
+} EditorHLEntry;
+
+// Bounded LRU memo of highlight results keyed by (content hash, incoming
+// comment state, syntax). Hits are checked against the stored row content.
+// A row refers to its entry by (hl_entry, hl_gen), entry 0 is the list
+// sentinel.
+typedef struct EditorHLCache {
+    VECTOR(uint8_t) pool;
+    VECTOR(EditorHLEntry) entries;
+    uint32_t* buckets;
+} EditorHLCache;
+
+typedef struct EditorHLSpanIter {
+    const uint8_t* p;
+    const uint8_t* end;
+    uint32_t pos;
+} EditorHLSpanIter;
+
+static inline uint32_t hlReadVarint(const uint8_t** p) {
+    uint32_t value = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+        byte = *(*p)++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
+}
+
+static inline bool editorHLSpanIterNext(EditorHLSpanIter* it,
+                                        EditorHLSpan* span) {
+    if (it->p >= it->end)
+        return false;
+    uint32_t head = hlReadVarint(&it->p);
+    span->type = head & 0xF;
+    span->start = it->pos + (head >> 4);
+    span->len = hlReadVarint(&it->p);
+    it->pos = span->start + span->len;
+    return true;
+}
+
+struct EditorSyntax {
     struct EditorSyntax* next;
 
     const char* file_type;
@@ -41,8 +111,12 @@ typedef struct EditorSyntax {
     VECTOR(const char*) keywords[3];
     uint32_t flags;
 
+    // Not NULL until the keywords are read from the JSON definition
     struct JsonValue* value;
-} EditorSyntax;
+
+    // Not NULL until the keywords are read from the compiled cache
+    const struct HLDBCacheSyntax* lazy;
+};
 
 // flags:
 // - HL_UPDATE_LAZY: Only detect multiline comment (hl_open_comment)
@@ -50,11 +124,25 @@ typedef struct EditorSyntax {
 // Probably doesn't make much sense to have both flags on though
 // return: number of rows updated
 int editorUpdateSyntax(EditorFile* file, EditorRow* row, int flags);
+// Same as editorUpdateSyntax, but always updates at least count rows
+int editorUpdateSyntaxRange(EditorFile* file,
+                            EditorRow* row,
+                            int count,
+                            int flags);
+// Get the cached spans of a row, highlighting it again if they were evicted
+const EditorHLEntry* editorGetRowHL(EditorFile* file, EditorRow* row);
+void editorHLSpanIterInit(EditorHLSpanIter* it,
+                          const EditorFile* file,
+                          const EditorHLEntry* entry);
+void editorClearHLCache(EditorHLCache* cache);
+void editorFreeHLCache(EditorHLCache* cache);
 void editorFileReloadHighlight(EditorFile* file);
 void editorSetSyntaxHighlight(EditorFile* file, EditorSyntax* syntax_def);
 void editorSelectSyntaxHighlight(EditorFile* file);
 void editorInitHLDB(void);
 bool editorLoadHLDB(const char* json_file);
 void editorFreeHLDB(void);
+// Reload every definition and rebind the open files
+void editorReloadHLDB(void);
 
 #endif
@@ -241,6 +241,26 @@ void editorScrollToCursor(int split_index) {
         rx = editorRowCxToRx(&file->row[tab->cursor.y], tab->cursor.x);
     }
 
+    EditorWrapLayout* layout = editorGetSplitWrap(split_index);
+    if (layout) {
+        int line = editorWrapLineOfRow(layout, tab->cursor.y);
+        if (tab->cursor.y < file->num_rows) {
+            line += editorRowWrapLine(&file->row[tab->cursor.y],
+                                      layout->width, rx);
+        }
+
+        int top = editorWrapGetTop(layout, tab);
+        if (line < top) {
+            top = line;
+        }
+        if (line >= top + gEditor.display_rows) {
+            top = line - gEditor.display_rows + 1;
+        }
+        editorWrapSetTop(layout, tab, top);
+        tab->col_offset = 0;
+        return;
+    }
+
     if (tab->cursor.y < tab->row_offset) {
         tab->row_offset = tab->cursor.y;
     }
@@ -257,6 +277,18 @@ void editorScrollToCursor(int split_index) {
 
 void editorScrollToCursorCenter(int split_index) {
     EditorTab* tab = editorSplitGetTab(split_index);
+
+    EditorWrapLayout* layout = editorGetSplitWrap(split_index);
+    if (layout) {
+        const EditorFile* file = editorTabGetFile(tab);
+        const EditorRow* row = &file->row[tab->cursor.y];
+        int line = editorWrapLineOfRow(layout, tab->cursor.y) +
+                   editorRowWrapLine(row, layout->width,
+                                     editorRowCxToRx(row, tab->cursor.x));
+        editorWrapSetTop(layout, tab, line - gEditor.display_rows / 2);
+        return;
+    }
+
     tab->row_offset = tab->cursor.y - gEditor.display_rows / 2;
     if (tab->row_offset < 0) {
         tab->row_offset = 0;
@@ -339,6 +371,41 @@ void editorMousePosToEditorPos(int split_index,
     const EditorTab* tab = editorSplitGetTab(split_index);
     const EditorFile* file = editorTabGetFile(tab);
 
+    int col = mouse_x - start - editorGetLinenoWidth(file);
+
+    EditorWrapLayout* layout = editorGetSplitWrap(split_index);
+    if (layout) {
+        // offset the top status bar
+        int line = editorWrapGetTop(layout, tab) + mouse_y - 1;
+        if (line >= editorWrapTotalLines(layout)) {
+            *out_y = file->num_rows - 1;
+            *out_x = file->row[*out_y].rsize;
+            return;
+        }
+
+        int sub;
+        int row = editorWrapRowOfLine(layout, line, &sub);
+        const EditorRow* row_data = &file->row[row];
+        int line_start = editorRowWrapStart(row_data, layout->width, sub);
+        int line_end = row_data->rsize;
+        if (sub < layout->counts[row] - 1) {
+            // Stay on this line instead of the first character of the next
+            line_end =
+                editorRowWrapStart(row_data, layout->width, sub + 1) - 1;
+        }
+
+        col += line_start;
+        if (col < line_start) {
+            col = line_start;
+        } else if (col > line_end) {
+            col = line_end;
+        }
+
+        *out_x = col;
+        *out_y = row;
+        return;
+    }
+
     int row = tab->row_offset + mouse_y - 1;  // offset the top status bar
     if (row < 0)
         return;
@@ -349,7 +416,7 @@ void editorMousePosToEditorPos(int split_index,
         return;
     }
 
-    int col = mouse_x - start - editorGetLinenoWidth(file) + tab->col_offset;
+    col += tab->col_offset;
     if (col < 0) {
         col = 0;
     } else if (col > file->row[row].rsize) {
@@ -364,6 +431,12 @@ void editorScroll(int split_index, int dist) {
     EditorTab* tab = editorSplitGetTab(split_index);
     const EditorFile* file = editorTabGetFile(tab);
 
+    EditorWrapLayout* layout = editorGetSplitWrap(split_index);
+    if (layout) {
+        editorWrapSetTop(layout, tab, editorWrapGetTop(layout, tab) + dist);
+        return;
+    }
+
     int line = tab->row_offset + dist;
     if (line < 0) {
         line = 0;
@@ -646,6 +719,7 @@ void editorProcessKeypress(void) {
     } else {
         input = editorReadKey();
     }
+    editorPerfInput(input.timestamp_ms);
 
     // Global keybinds
     switch (input.type) {
@@ -700,6 +774,8 @@ void editorProcessKeypress(void) {
 
     bool should_set_cursor = false;
     int next_bracket_autocomplete = tab->bracket_autocomplete;
+    // Typing and deleting can continue the last undo step
+    bool can_merge = false;
 
     int c = input.type;
     switch (c) {
@@ -713,7 +789,7 @@ void editorProcessKeypress(void) {
             EditorSelectRange delete_range = {0};
             if (tab->cursor.is_selected) {
                 getSelectStartEnd(&tab->cursor, &delete_range);
-                editorCopyText(file, &edit.before, delete_range);
+                editorEditSetBefore(file, &edit, delete_range);
             }
 
             editorFreeClipboardContent(&edit.after);
@@ -1008,7 +1084,7 @@ void editorProcessKeypress(void) {
                 getSelectStartEnd(&tab->cursor, &range);
                 edit.x = range.start_x;
                 edit.y = range.start_y;
-                editorCopyText(file, &edit.before, range);
+                editorEditSetBefore(file, &edit, range);
                 editorFreeClipboardContent(&edit.after);
                 should_set_cursor = true;
                 new_cursor = tab->cursor;
@@ -1088,6 +1164,7 @@ void editorProcessKeypress(void) {
             }
 
             EditorSelectRange range = {start_x, start_y, end_x, end_y};
+            can_merge = true;
             edit.x = range.start_x;
             edit.y = range.start_y;
             editorCopyText(file, &edit.before, range);
@@ -1143,7 +1220,7 @@ void editorProcessKeypress(void) {
                 getSelectStartEnd(&tab->cursor, &range);
                 edit.x = range.start_x;
                 edit.y = range.start_y;
-                editorCopyText(file, &edit.before, range);
+                editorEditSetBefore(file, &edit, range);
                 editorFreeClipboardContent(&edit.after);
                 editorCopyText(file, &gEditor.clipboard, range);
                 gEditor.copy_line = false;
@@ -1193,13 +1270,18 @@ void editorProcessKeypress(void) {
             };
             if (tab->cursor.is_selected) {
                 getSelectStartEnd(&tab->cursor, &delete_range);
-                editorCopyText(file, &edit.before, delete_range);
+                editorEditSetBefore(file, &edit, delete_range);
             }
 
             edit.x = delete_range.start_x;
             edit.y = delete_range.start_y;
             editorFreeClipboardContent(&edit.after);
-            if (clipboard->size > 0) {
+            if (c == PASTE_INPUT) {
+                // Take the lines from the input instead of copying them
+                edit.after = input.data.paste;
+                input.data.paste.size = 0;
+                input.data.paste.lines = NULL;
+            } else if (clipboard->size > 0) {
                 edit.after.size = clipboard->size;
                 edit.after.lines = malloc_s(sizeof(Str) * edit.after.size);
                 for (size_t i = 0; i < clipboard->size; i++) {
@@ -1306,7 +1388,15 @@ void editorProcessKeypress(void) {
             if (c == PAGE_UP || c == SHIFT_PAGE_UP) {
                 tab->cursor.y = tab->row_offset;
             } else if (c == PAGE_DOWN || c == SHIFT_PAGE_DOWN) {
-                tab->cursor.y = tab->row_offset + gEditor.display_rows - 1;
+                EditorWrapLayout* layout =
+                    editorGetSplitWrap(gEditor.split_active_index);
+                if (layout) {
+                    int bottom = editorWrapGetTop(layout, tab) +
+                                 gEditor.display_rows - 1;
+                    tab->cursor.y = editorWrapRowOfLine(layout, bottom, NULL);
+                } else {
+                    tab->cursor.y = tab->row_offset + gEditor.display_rows - 1;
+                }
                 if (tab->cursor.y >= file->num_rows)
                     tab->cursor.y = file->num_rows - 1;
             }
@@ -1618,11 +1708,8 @@ void editorProcessKeypress(void) {
                     tab = editorSplitGetTab(split_index);
                     file = editorTabGetFile(tab);
 
-                    int row = tab->row_offset + in_y - 1;
-                    if (row < 0)
-                        row = 0;
-                    if (row >= file->num_rows)
-                        row = file->num_rows - 1;
+                    int x, row;
+                    editorMousePosToEditorPos(split_index, 0, in_y, &x, &row);
                     mouse_pressed_field = FIELD_LINENO;
                     mouse_pressed_split_index = split_index;
                     mouse_pressed_row = row;
@@ -1848,8 +1935,10 @@ void editorProcessKeypress(void) {
 
             if (tab->cursor.is_selected) {
                 getSelectStartEnd(&tab->cursor, &delete_range);
-                editorCopyText(file, &edit.before, delete_range);
+                editorEditSetBefore(file, &edit, delete_range);
                 tab->cursor.is_selected = false;
+            } else {
+                can_merge = true;
             }
 
             edit.x = delete_range.start_x;
@@ -1939,6 +2028,7 @@ void editorProcessKeypress(void) {
     }
 
     if (has_edit) {
+        edit.move_after = editorEditCanMove(file, edit.after.size);
         editorApplyEdit(tab, &edit, false);
         if (should_set_cursor) {
             tab->cursor = new_cursor;
@@ -1946,13 +2036,15 @@ void editorProcessKeypress(void) {
         }
         tab->bracket_autocomplete = next_bracket_autocomplete;
 
-        EditorAction* action = calloc_s(1, sizeof(EditorAction));
-        action->type = ACTION_EDIT;
-        EditAction* edit_action = &action->edit;
-        edit_action->data = edit;
-        edit_action->old_cursor = old_cursor;
-        edit_action->new_cursor = tab->cursor;
-        editorAppendAction(file, action);
+        if (!can_merge || !editorMergeEdit(file, &edit, tab->cursor,
+                                           input.timestamp_ms)) {
+            EditorAction action = {.type = ACTION_EDIT};
+            action.edit.data = edit;
+            action.edit.old_cursor = old_cursor;
+            action.edit.new_cursor = tab->cursor;
+            action.edit.time_ms = input.timestamp_ms;
+            editorAppendAction(file, &action);
+        }
     }
 
     if (tab->cursor.x == tab->cursor.select_x &&
@@ -1969,3 +2061,54 @@ void editorProcessKeypress(void) {
         editorScrollToCursor(gEditor.split_active_index);
     }
 }
+
+// Longest time spent on queued input before drawing a frame anyway
+#define INPUT_BUDGET_MS 50
+
+// Handle the next input and then whatever is already queued behind it, so a
+// burst of input is drawn as a single frame. frame_start is when the last
+// frame started, used to keep under max_fps.
+void editorProcessInput(int64_t frame_start) {
+    EditorPerfPhase phase = editorPerfEnter(PERF_INPUT);
+    editorProcessKeypress();
+
+    int frame_ms = max_fps.int_value > 0 ? 1000 / max_fps.int_value : 0;
+    int64_t input_start = getTimeMs();
+
+    while (gEditor.state != STATE_EXIT) {
+        int64_t now = getTimeMs();
+        if (now - input_start >= INPUT_BUDGET_MS)
+            break;
+
+        int timeout = (int)(frame_start + frame_ms - now);
+        if (timeout < 0)
+            timeout = 0;
+
+        if (gEditor.pending_input.type == UNKNOWN) {
+            editorPerfEnter(PERF_IDLE);
+            bool pending = isConsoleInputPending(timeout);
+            editorPerfEnter(PERF_INPUT);
+            if (!pending)
+                break;
+
+            // Only the last of consecutive mouse moves matters
+            EditorInput input = editorReadKey();
+            while (input.type == MOUSE_MOVE && isConsoleInputPending(0)) {
+                EditorInput next = editorReadKey();
+                if (next.type != MOUSE_MOVE) {
+                    gEditor.pending_input = input;
+                    editorProcessKeypress();
+                    if (gEditor.state == STATE_EXIT) {
+                        editorPerfLeave(phase);
+                        return;
+                    }
+                }
+                input = next;
+            }
+            gEditor.pending_input = input;
+        }
+
+        editorProcessKeypress();
+    }
+    editorPerfLeave(phase);
+}
@@ -14,6 +14,7 @@ enum EditorField {
 };
 
 void editorProcessKeypress(void);
+void editorProcessInput(int64_t frame_start);
 
 void editorScrollToCursor(int split_index);
 void editorScrollToCursorCenter(int split_index);
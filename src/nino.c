@@ -135,8 +135,10 @@ int main(int argc, char* argv[]) {
     }
 
     while (gEditor.state != STATE_EXIT) {
+        int64_t frame_start = getTimeMs();
         editorRefreshScreen();
-        editorProcessKeypress();
+        editorFlushUndoJournals();
+        editorProcessInput(frame_start);
     }
 
 DONE:
@@ -45,6 +45,13 @@ typedef struct {
 } ConsoleEvent;
 
 ConsoleEvent readConsoleEvent(int timeout_ms);
+// Whether a key can be read without waiting longer than timeout_ms
+bool isConsoleInputPending(int timeout_ms);
+// Raw UTF-8 input for bulk reads. Waits up to timeout_ms if nothing is
+// buffered, returns the number of bytes at *data. They stay buffered until
+// consumed.
+size_t peekConsoleInput(const char** data, int timeout_ms);
+void consumeConsoleInput(size_t count);
 int writeConsole(const void* buf, size_t count);
 int getWindowSize(int* rows, int* cols);
 
@@ -53,6 +60,12 @@ typedef struct FileInfo FileInfo;
 FileInfo getFileInfo(const char* path);
 bool areFilesEqual(FileInfo f1, FileInfo f2);
 bool isFileModified(FileInfo f1, FileInfo f2);
+uint64_t getFileInfoSize(FileInfo info);
+int64_t getFileInfoMtime(FileInfo info);
+
+// Read-only mapping of a whole file, NULL on failure or empty file
+void* mapFile(const char* path, size_t* size);
+void unmapFile(void* addr, size_t size);
 
 typedef enum FileType {
     FT_INVALID = -1,
@@ -72,8 +85,16 @@ void dirClose(DirIter* iter);
 const char* dirGetName(const DirIter* iter);
 bool pathExists(const char* path);
 bool canWriteFile(const char* path);
+// Succeeds if the directory already exists
+bool makeDir(const char* path);
 
 FILE* openFile(const char* path, const char* mode);
+// Binary read/write file removed when closed
+FILE* openTempFile(void);
+bool seekFile(FILE* fp, uint64_t offset);
+// Exclusive lock held until the file is closed, fails without waiting if
+// another process holds it
+bool lockFile(FILE* fp);
 bool shouldSaveInPlace(const char* path);
 OsError saveFileInPlace(const char* path, const void* buf, size_t len);
 OsError saveFileReplace(const char* path, const void* buf, size_t len);
@@ -82,6 +103,15 @@ char* getFullPath(const char* path);
 
 // Time
 int64_t getTimeMs(void);
+int64_t getTimeUs(void);
+
+// Thread
+typedef void (*ThreadProc)(void* arg);
+typedef struct Thread Thread;
+// thread must stay valid until joined
+bool threadCreate(Thread* thread, ThreadProc proc, void* arg);
+void threadJoin(Thread* thread);
+int getCPUCount(void);
 
 // Environment
 const char* getEnv(const char* name);
@@ -4,7 +4,9 @@
 #include <fcntl.h>
 #include <poll.h>
 #include <signal.h>
+#include <sys/file.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 #include <termios.h>
 #include <time.h>
@@ -13,6 +15,8 @@
 #include "terminal.h"
 #include "utils.h"
 
+#ifndef OS_HEADLESS
+
 #define SIGWINCH_BYTE 0x01
 #define SIGTSTP_BYTE 0x02
 #define SIGCONT_BYTE 0x03
@@ -134,7 +138,16 @@ void disableRawMode(void) {
 
 static bool has_pending_resize = false;
 
-static bool readConsoleByte(uint8_t* out, int timeout_ms) {
+// Input is read in chunks and handed out a byte at a time
+#define INPUT_BUFFER_SIZE (64 * 1024)
+
+static uint8_t input_buf[INPUT_BUFFER_SIZE];
+static size_t input_start = 0;
+static size_t input_end = 0;
+
+// Reads what's available into the empty input buffer. Returns false on
+// timeout, or on a resize when stop_on_resize is set.
+static bool fillInputBuffer(int timeout_ms, bool stop_on_resize) {
     struct pollfd fds[2] = {
         {.fd = tty_fd, .events = POLLIN},
         {.fd = sig_rd, .events = POLLIN},
@@ -145,8 +158,14 @@ static bool readConsoleByte(uint8_t* out, int timeout_ms) {
         if (ret <= 0)
             return false;
 
-        if (fds[0].revents & POLLIN)
-            return read(tty_fd, out, 1) == 1;
+        if (fds[0].revents & POLLIN) {
+            ssize_t n = read(tty_fd, input_buf, sizeof(input_buf));
+            if (n <= 0)
+                return false;
+            input_start = 0;
+            input_end = (size_t)n;
+            return true;
+        }
 
         if (fds[1].revents & POLLIN) {
             uint8_t buf[64];
@@ -179,12 +198,39 @@ static bool readConsoleByte(uint8_t* out, int timeout_ms) {
                         break;
                 }
             }
-            if (has_pending_resize)
+            if (has_pending_resize && stop_on_resize)
                 return false;
         }
     }
 }
 
+static bool readConsoleByte(uint8_t* out, int timeout_ms) {
+    if (input_start == input_end && !fillInputBuffer(timeout_ms, true))
+        return false;
+    *out = input_buf[input_start++];
+    return true;
+}
+
+size_t peekConsoleInput(const char** data, int timeout_ms) {
+    // A pending resize is reported by the next readConsoleEvent
+    if (input_start == input_end && !fillInputBuffer(timeout_ms, false))
+        return 0;
+    *data = (const char*)&input_buf[input_start];
+    return input_end - input_start;
+}
+
+void consumeConsoleInput(size_t count) {
+    input_start += count;
+}
+
+bool isConsoleInputPending(int timeout_ms) {
+    if (input_start < input_end)
+        return true;
+
+    struct pollfd pfd = {.fd = tty_fd, .events = POLLIN};
+    return poll(&pfd, 1, timeout_ms) > 0 && (pfd.revents & POLLIN);
+}
+
 ConsoleEvent readConsoleEvent(int timeout_ms) {
     ConsoleEvent ev = {.type = CONSOLE_EVENT_NONE};
 
@@ -270,6 +316,8 @@ int getWindowSize(int* rows, int* cols) {
     return -1;
 }
 
+#endif  // !OS_HEADLESS
+
 FileInfo getFileInfo(const char* path) {
     FileInfo info;
     info.error = (stat(path, &info.info) == -1);
@@ -285,6 +333,38 @@ bool isFileModified(FileInfo f1, FileInfo f2) {
     return (f1.info.st_mtime != f2.info.st_mtime);
 }
 
+uint64_t getFileInfoSize(FileInfo info) {
+    return (uint64_t)info.info.st_size;
+}
+
+int64_t getFileInfoMtime(FileInfo info) {
+    return (int64_t)info.info.st_mtime;
+}
+
+void* mapFile(const char* path, size_t* size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        return NULL;
+
+    *size = (size_t)st.st_size;
+    return addr;
+}
+
+void unmapFile(void* addr, size_t size) {
+    munmap(addr, size);
+}
+
 FileType getFileType(const char* path) {
     if (path[0] == '\0') {
         return FT_INVALID;
@@ -358,10 +438,26 @@ bool canWriteFile(const char* path) {
     return true;
 }
 
+bool makeDir(const char* path) {
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
 FILE* openFile(const char* path, const char* mode) {
     return fopen(path, mode);
 }
 
+FILE* openTempFile(void) {
+    return tmpfile();
+}
+
+bool seekFile(FILE* fp, uint64_t offset) {
+    return fseeko(fp, (off_t)offset, SEEK_SET) == 0;
+}
+
+bool lockFile(FILE* fp) {
+    return flock(fileno(fp), LOCK_EX | LOCK_NB) == 0;
+}
+
 bool shouldSaveInPlace(const char* path) {
     struct stat st;
     if (lstat(path, &st) == -1) {
@@ -528,6 +624,12 @@ char* getFullPath(const char* path) {
     return resolved_path;
 }
 
+const char* getEnv(const char* name) {
+    return getenv(name);
+}
+
+#ifndef OS_HEADLESS
+
 void osSuspend(void) {
     kill(0, SIGTSTP);
 }
@@ -559,10 +661,6 @@ static void installSignalHandlers(void) {
     sigaction(SIGCONT, &cont_action, NULL);
 }
 
-const char* getEnv(const char* name) {
-    return getenv(name);
-}
-
 void osRunShell(const char* shell_hint, const char* cmd) {
     const char* shell = NULL;
     if (shell_hint && shell_hint[0] && access(shell_hint, X_OK) == 0) {
@@ -639,12 +737,41 @@ void osRunShell(const char* shell_hint, const char* cmd) {
     terminalStart();
 }
 
+#endif  // !OS_HEADLESS
+
 int64_t getTimeMs(void) {
     struct timespec ts;
     clock_gettime(CLOCK_MONOTONIC, &ts);
     return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
+int64_t getTimeUs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void* threadStart(void* arg) {
+    Thread* thread = arg;
+    thread->proc(thread->arg);
+    return NULL;
+}
+
+bool threadCreate(Thread* thread, ThreadProc proc, void* arg) {
+    thread->proc = proc;
+    thread->arg = arg;
+    return pthread_create(&thread->handle, NULL, threadStart, thread) == 0;
+}
+
+void threadJoin(Thread* thread) {
+    pthread_join(thread->handle, NULL);
+}
+
+int getCPUCount(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
+
 void argsInit(int* argc, char*** argv) {
     UNUSED(argc);
     UNUSED(argv);
@@ -3,6 +3,7 @@
 
 #include <dirent.h>
 #include <limits.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -29,6 +30,12 @@ struct DirIter {
     bool error;
 };
 
+struct Thread {
+    pthread_t handle;
+    void (*proc)(void* arg);
+    void* arg;
+};
+
 typedef int OsError;
 
 #endif
@@ -4,6 +4,9 @@
 
 #include "os.h"
 #include "terminal.h"
+#include "unicode.h"
+
+#ifndef OS_HEADLESS
 
 static HANDLE hStdin = INVALID_HANDLE_VALUE;
 static HANDLE hStdout = INVALID_HANDLE_VALUE;
@@ -89,10 +92,10 @@ void disableRawMode(void) {
 static bool has_pending_resize = false;
 static ConsoleSize pending_resize = {0, 0};
 
-static bool readConsoleWChar(WCHAR* out, int timeout_ms) {
-    static DWORD repeat_left = 0;
-    static WCHAR repeat_char = 0;
+static DWORD repeat_left = 0;
+static WCHAR repeat_char = 0;
 
+static bool readConsoleWChar(WCHAR* out, int timeout_ms) {
     if (repeat_left) {
         *out = repeat_char;
         repeat_left--;
@@ -160,6 +163,36 @@ static bool readConsoleWChar(WCHAR* out, int timeout_ms) {
     return false;
 }
 
+// Input peeked by peekConsoleInput, encoded as UTF-8
+#define RAW_INPUT_SIZE 4096
+
+static char raw_input[RAW_INPUT_SIZE];
+static size_t raw_start = 0;
+static size_t raw_end = 0;
+
+bool isConsoleInputPending(int timeout_ms) {
+    if (repeat_left || raw_start < raw_end)
+        return true;
+
+    DWORD wait = (timeout_ms < 0) ? INFINITE : (DWORD)timeout_ms;
+    if (WaitForSingleObject(hConIn, wait) != WAIT_OBJECT_0)
+        return false;
+
+    // Only key presses produce input
+    INPUT_RECORD recs[16];
+    DWORD count = 0;
+    if (!PeekConsoleInputW(hConIn, recs, 16, &count))
+        return false;
+
+    for (DWORD i = 0; i < count; i++) {
+        if (recs[i].EventType == KEY_EVENT &&
+            recs[i].Event.KeyEvent.bKeyDown &&
+            recs[i].Event.KeyEvent.uChar.UnicodeChar)
+            return true;
+    }
+    return false;
+}
+
 int writeConsole(const void* buf, size_t count) {
     DWORD bytes_written;
     if (WriteFile(hConOut, buf, count, &bytes_written, NULL)) {
@@ -186,6 +219,15 @@ ConsoleEvent readConsoleEvent(int timeout_ms) {
         return ev;
     }
 
+    if (raw_start < raw_end) {
+        size_t byte_size;
+        ev.type = CONSOLE_EVENT_KEY;
+        ev.data.unicode = decodeUTF8(&raw_input[raw_start],
+                                     raw_end - raw_start, &byte_size);
+        raw_start += byte_size ? byte_size : 1;
+        return ev;
+    }
+
     WCHAR b0;
     if (!readConsoleWChar(&b0, timeout_ms)) {
         if (has_pending_resize) {
@@ -218,6 +260,40 @@ ConsoleEvent readConsoleEvent(int timeout_ms) {
     return ev;
 }
 
+size_t peekConsoleInput(const char** data, int timeout_ms) {
+    if (raw_start == raw_end) {
+        raw_start = 0;
+        raw_end = 0;
+
+        // Resize events are kept pending for readConsoleEvent
+        WCHAR w;
+        int timeout = timeout_ms;
+        while (raw_end + 4 <= RAW_INPUT_SIZE && readConsoleWChar(&w, timeout)) {
+            uint32_t unicode = 0xFFFD;
+            if (isHighSurrogate(w)) {
+                WCHAR low;
+                if (readConsoleWChar(&low, READ_GRACE_MS) &&
+                    isLowSurrogate(low)) {
+                    uint32_t hs = (uint32_t)w - 0xD800;
+                    uint32_t ls = (uint32_t)low - 0xDC00;
+                    unicode = 0x10000 + ((hs << 10) | ls);
+                }
+            } else if (!isLowSurrogate(w)) {
+                unicode = w;
+            }
+            raw_end += encodeUTF8(unicode, &raw_input[raw_end]);
+            timeout = 0;
+        }
+    }
+
+    *data = &raw_input[raw_start];
+    return raw_end - raw_start;
+}
+
+void consumeConsoleInput(size_t count) {
+    raw_start += count;
+}
+
 int getWindowSize(int* rows, int* cols) {
     CONSOLE_SCREEN_BUFFER_INFO csbi;
 
@@ -229,6 +305,8 @@ int getWindowSize(int* rows, int* cols) {
     return -1;
 }
 
+#endif  // !OS_HEADLESS
+
 FileInfo getFileInfo(const char* path) {
     FileInfo info;
     wchar_t w_path[EDITOR_PATH_MAX] = {0};
@@ -266,6 +344,52 @@ bool isFileModified(FileInfo f1, FileInfo f2) {
                 f2.info.ftLastWriteTime.dwHighDateTime);
 }
 
+uint64_t getFileInfoSize(FileInfo info) {
+    return ((uint64_t)info.info.nFileSizeHigh << 32) | info.info.nFileSizeLow;
+}
+
+int64_t getFileInfoMtime(FileInfo info) {
+    return ((int64_t)info.info.ftLastWriteTime.dwHighDateTime << 32) |
+           info.info.ftLastWriteTime.dwLowDateTime;
+}
+
+void* mapFile(const char* path, size_t* size) {
+    wchar_t w_path[EDITOR_PATH_MAX] = {0};
+    MultiByteToWideChar(CP_UTF8, 0, path, -1, w_path, EDITOR_PATH_MAX);
+
+    // The file may also be open for writing, e.g. the undo journal
+    HANDLE h =
+        CreateFileW(w_path, GENERIC_READ,
+                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                    NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (h == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(h, &file_size) || file_size.QuadPart <= 0) {
+        CloseHandle(h);
+        return NULL;
+    }
+
+    HANDLE mapping = CreateFileMappingW(h, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(h);
+    if (!mapping)
+        return NULL;
+
+    void* addr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!addr)
+        return NULL;
+
+    *size = (size_t)file_size.QuadPart;
+    return addr;
+}
+
+void unmapFile(void* addr, size_t size) {
+    UNUSED(size);
+    UnmapViewOfFile(addr);
+}
+
 FileType getFileType(const char* path) {
     if (path[0] == '\0') {
         return FT_INVALID;
@@ -383,6 +507,14 @@ bool canWriteFile(const char* path) {
     return true;
 }
 
+bool makeDir(const char* path) {
+    wchar_t w_path[EDITOR_PATH_MAX] = {0};
+    MultiByteToWideChar(CP_UTF8, 0, path, -1, w_path, EDITOR_PATH_MAX);
+
+    return CreateDirectoryW(w_path, NULL) ||
+           GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
 FILE* openFile(const char* path, const char* mode) {
     wchar_t w_path[EDITOR_PATH_MAX] = {0};
     MultiByteToWideChar(CP_UTF8, 0, path, -1, w_path, EDITOR_PATH_MAX);
@@ -394,6 +526,27 @@ FILE* openFile(const char* path, const char* mode) {
     return file;
 }
 
+FILE* openTempFile(void) {
+    return tmpfile();
+}
+
+bool seekFile(FILE* fp, uint64_t offset) {
+    return _fseeki64(fp, (__int64)offset, SEEK_SET) == 0;
+}
+
+bool lockFile(FILE* fp) {
+    HANDLE h = (HANDLE)_get_osfhandle(_fileno(fp));
+    if (h == INVALID_HANDLE_VALUE)
+        return false;
+
+    // Lock a byte past any content so reads and mappings are not blocked
+    OVERLAPPED ov = {0};
+    ov.Offset = 0xFFFFFFFF;
+    ov.OffsetHigh = 0x7FFFFFFF;
+    return LockFileEx(h, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY,
+                      0, 1, 0, &ov);
+}
+
 static OsError writeFile(HANDLE h, const void* buf, size_t len) {
     OsError err;
 
@@ -597,6 +750,42 @@ int64_t getTimeMs(void) {
     return GetTickCount64();
 }
 
+int64_t getTimeUs(void) {
+    static LARGE_INTEGER freq;
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (int64_t)(counter.QuadPart / freq.QuadPart * 1000000 +
+                     counter.QuadPart % freq.QuadPart * 1000000 /
+                         freq.QuadPart);
+}
+
+static DWORD WINAPI threadStart(LPVOID arg) {
+    Thread* thread = arg;
+    thread->proc(thread->arg);
+    return 0;
+}
+
+bool threadCreate(Thread* thread, ThreadProc proc, void* arg) {
+    thread->proc = proc;
+    thread->arg = arg;
+    thread->handle = CreateThread(NULL, 0, threadStart, thread, 0, NULL);
+    return thread->handle != NULL;
+}
+
+void threadJoin(Thread* thread) {
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+}
+
+int getCPUCount(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
 void argsInit(int* argc, char*** argv) {
     LPWSTR* w_argv = CommandLineToArgvW(GetCommandLineW(), argc);
     if (!w_argv)
@@ -619,6 +808,8 @@ void argsFree(int argc, char** argv) {
     free(argv);
 }
 
+#ifndef OS_HEADLESS
+
 void osSuspend(void) {
     // Not supported on Windows
 }
@@ -690,6 +881,8 @@ void osRunShell(const char* shell_hint, const char* cmd) {
     terminalStart();
 }
 
+#endif  // !OS_HEADLESS
+
 const char* getEnv(const char* name) {
     static char result[EDITOR_PATH_MAX * 4];
 
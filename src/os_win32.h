@@ -26,6 +26,12 @@ struct DirIter {
     bool error;
 };
 
+struct Thread {
+    HANDLE handle;
+    void (*proc)(void* arg);
+    void* arg;
+};
+
 typedef DWORD OsError;
 
 #endif
@@ -25,89 +25,336 @@ static inline bool graphemeEql(const Grapheme* a, const Grapheme* b) {
     return true;
 }
 
-static bool cellEql(const ScreenCell* a, const ScreenCell* b) {
-    if (a->continuation != b->continuation)
-        return false;
-    if (a->continuation)
-        return true;
+// Styles and multi code point graphemes are interned, so cells stay small
+// and compare by id. Ids live until the tables are reset, which forces a
+// full redraw.
+#define SCREEN_TABLE_MAX 4096
+#define SCREEN_TABLE_BUCKETS (SCREEN_TABLE_MAX * 2)
+
+// SGR sequences of a style, built once when it is interned
+typedef struct ScreenStyleSGR {
+    char fg[24];
+    char bg[24];
+    char both[48];
+    uint8_t fg_len;
+    uint8_t bg_len;
+    uint8_t both_len;
+} ScreenStyleSGR;
+
+// Output buffer kept across frames
+#define FRAME_KEEP_MIN (64 * 1024)
+static abuf frame = ABUF_INIT;
+
+static struct {
+    VECTOR(ScreenStyle) styles;
+    VECTOR(ScreenStyleSGR) sgr;
+    VECTOR(Grapheme) clusters;
+    // Index + 1, 0 if empty
+    uint16_t style_buckets[SCREEN_TABLE_BUCKETS];
+    uint16_t cluster_buckets[SCREEN_TABLE_BUCKETS];
+
+    ScreenStyle last_style;
+    uint16_t last_style_id;
+    bool has_last_style;
+} screen_table;
+
+// Changes when cached cells can no longer be reused: the style and glyph
+// ids were reset, or a setting that changes how text is drawn was changed.
+static uint32_t style_epoch = 0;
+
+static void screenResetTables(void) {
+    style_epoch++;
+    vector_free(screen_table.styles);
+    vector_free(screen_table.sgr);
+    vector_free(screen_table.clusters);
+    memset(screen_table.style_buckets, 0, sizeof(screen_table.style_buckets));
+    memset(screen_table.cluster_buckets, 0,
+           sizeof(screen_table.cluster_buckets));
+    screen_table.has_last_style = false;
+}
 
-    if (!graphemeEql(&a->grapheme, &b->grapheme))
-        return false;
+static inline uint32_t colorKey(Color color) {
+    switch (color.kind) {
+        case COLOR_ANSI16:
+        case COLOR_256:
+            return (uint32_t)color.kind << 24 | color.index;
+        case COLOR_RGB:
+            return (uint32_t)color.kind << 24 | (uint32_t)color.r << 16 |
+                   (uint32_t)color.g << 8 | color.b;
+        default:
+            return (uint32_t)color.kind << 24;
+    }
+}
+
+static void screenBuildSGR(ScreenStyleSGR* sgr, const ScreenStyle* style) {
+    abuf ab = ABUF_INIT;
+
+    setColor(&ab, style->fg, false);
+    sgr->fg_len = ab.len;
+    memcpy(sgr->fg, ab.buf, ab.len);
+    ab.len = 0;
+
+    setColor(&ab, style->bg, true);
+    sgr->bg_len = ab.len;
+    memcpy(sgr->bg, ab.buf, ab.len);
+    ab.len = 0;
+
+    setColors(&ab, style->fg, style->bg);
+    sgr->both_len = ab.len;
+    memcpy(sgr->both, ab.buf, ab.len);
+
+    abufFree(&ab);
+}
+
+static void screenUpdateStyleEpoch(void) {
+    static uint64_t last_key = 0;
 
-    return styleEql(&a->style, &b->style);
+    uint64_t key = 0;
+    for (int i = 0; i < UI_COLOR_COUNT; i++) {
+        key = key * 0x100000001B3ull + colorKey(gEditor.color_cfg[i]);
+    }
+    key = key * 0x100000001B3ull + drawspace.int_value;
+    key = key * 0x100000001B3ull + trailing.int_value;
+    key = key * 0x100000001B3ull + tabsize.int_value;
+
+    if (key != last_key) {
+        last_key = key;
+        style_epoch++;
+    }
 }
 
-static bool editorScreenRowUpdated(int index) {
-    const ScreenCell* row = gEditor.screen[index];
-    const ScreenCell* prev_row = gEditor.prev_screen[index];
-    for (int i = 0; i < gEditor.screen_cols; i++) {
-        if (!cellEql(&row[i], &prev_row[i])) {
-            return true;
+static uint16_t screenStyleId(const ScreenStyle* style) {
+    if (screen_table.has_last_style &&
+        styleEql(&screen_table.last_style, style))
+        return screen_table.last_style_id;
+
+    uint64_t key = (uint64_t)colorKey(style->fg) << 32 | colorKey(style->bg);
+    uint32_t slot = hashBytes(&key, sizeof(key), 0) % SCREEN_TABLE_BUCKETS;
+
+    uint16_t id = 0;
+    while (screen_table.style_buckets[slot]) {
+        uint16_t index = screen_table.style_buckets[slot] - 1;
+        if (styleEql(&screen_table.styles.data[index], style)) {
+            id = index;
+            goto found;
         }
+        slot = (slot + 1) % SCREEN_TABLE_BUCKETS;
+    }
+
+    // Full, this shouldn't happen
+    if (screen_table.styles.size >= SCREEN_TABLE_BUCKETS - 1)
+        return 0;
+
+    id = screen_table.styles.size;
+    vector_push(screen_table.styles, *style);
+    ScreenStyleSGR sgr;
+    screenBuildSGR(&sgr, style);
+    vector_push(screen_table.sgr, sgr);
+    screen_table.style_buckets[slot] = id + 1;
+
+found:
+    screen_table.last_style = *style;
+    screen_table.last_style_id = id;
+    screen_table.has_last_style = true;
+    return id;
+}
+
+static inline const ScreenStyle* screenGetStyle(uint16_t id) {
+    return &screen_table.styles.data[id];
+}
+
+static uint32_t screenGraphemeGlyph(const Grapheme* grapheme) {
+    if (grapheme->size == 1)
+        return grapheme->cluster[0];
+
+    uint32_t slot = hashBytes(grapheme->cluster,
+                              grapheme->size * sizeof(uint32_t), 0) %
+                    SCREEN_TABLE_BUCKETS;
+    while (screen_table.cluster_buckets[slot]) {
+        uint32_t index = screen_table.cluster_buckets[slot] - 1;
+        if (graphemeEql(&screen_table.clusters.data[index], grapheme))
+            return SCREEN_GLYPH_CLUSTER | index;
+        slot = (slot + 1) % SCREEN_TABLE_BUCKETS;
+    }
+
+    // Full, keep only the base character
+    if (screen_table.clusters.size >= SCREEN_TABLE_BUCKETS - 1)
+        return grapheme->cluster[0];
+
+    uint32_t index = screen_table.clusters.size;
+    vector_push(screen_table.clusters, *grapheme);
+    screen_table.cluster_buckets[slot] = index + 1;
+    return SCREEN_GLYPH_CLUSTER | index;
+}
+
+static void screenCellGrapheme(const ScreenCell* cell, Grapheme* grapheme) {
+    if (cell->glyph & SCREEN_GLYPH_CLUSTER) {
+        *grapheme = screen_table.clusters
+                        .data[cell->glyph & ~SCREEN_GLYPH_CLUSTER];
+    } else {
+        grapheme->cluster[0] = cell->glyph;
+        grapheme->size = 1;
     }
-    return false;
+    grapheme->width = cell->width;
+}
+
+static inline bool cellEql(const ScreenCell* a, const ScreenCell* b) {
+    return a->glyph == b->glyph && a->style == b->style &&
+           a->width == b->width;
+}
+
+// Position dependent so a row hash is just the sum of its cell hashes and
+// can be updated one cell at a time.
+static inline uint64_t screenCellHash(const ScreenCell* cell, int x) {
+    uint64_t h = (uint64_t)cell->glyph | (uint64_t)cell->style << 32 |
+                 (uint64_t)cell->width << 48;
+    h ^= (uint64_t)x * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 31;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 29;
+    return h;
+}
+
+static uint64_t screenHashRow(const ScreenCell* cells, int cols) {
+    uint64_t hash = 0;
+    for (int i = 0; i < cols; i++) {
+        hash += screenCellHash(&cells[i], i);
+    }
+    return hash;
+}
+
+static inline void screenSetCell(ScreenRow* row, int x, ScreenCell cell) {
+    ScreenCell* old = &row->cells[x];
+    if (cellEql(old, &cell))
+        return;
+    row->hash += screenCellHash(&cell, x) - screenCellHash(old, x);
+    *old = cell;
+    row->dirty = true;
+}
+
+static inline bool editorScreenRowUpdated(int index) {
+    const ScreenRow* row = &gEditor.screen[index];
+    return row->dirty && row->hash != gEditor.prev_screen[index].hash;
 }
 
-static void updateStyle(abuf* ab,
-                        const ScreenStyle* old_style,
-                        const ScreenStyle* new_style) {
-    if (!new_style)
+// old_style is -1 if the terminal style is unknown
+static void updateStyle(abuf* ab, int old_style, uint16_t new_style) {
+    if (old_style == new_style)
+        return;
+
+    const ScreenStyleSGR* sgr = &screen_table.sgr.data[new_style];
+    if (old_style < 0) {
+        abufAppendN(ab, sgr->both, sgr->both_len);
         return;
+    }
 
-    bool update_fg = (!old_style || !colorEql(old_style->fg, new_style->fg));
-    bool update_bg = (!old_style || !colorEql(old_style->bg, new_style->bg));
+    const ScreenStyle* old = screenGetStyle(old_style);
+    const ScreenStyle* new = screenGetStyle(new_style);
+    bool update_fg = !colorEql(old->fg, new->fg);
+    bool update_bg = !colorEql(old->bg, new->bg);
     if (update_fg && update_bg) {
-        setColors(ab, new_style->fg, new_style->bg);
+        abufAppendN(ab, sgr->both, sgr->both_len);
     } else if (update_fg) {
-        setColor(ab, new_style->fg, false);
+        abufAppendN(ab, sgr->fg, sgr->fg_len);
     } else if (update_bg) {
-        setColor(ab, new_style->bg, true);
+        abufAppendN(ab, sgr->bg, sgr->bg_len);
     }
 }
 
-static Grapheme grapheme_space = {
-    .cluster = {[0] = ' '},
-    .size = 1,
-    .width = 1,
-};
+// Blank runs at least this long are erased instead of written
+#define RENDER_ERASE_MIN 12
+// Unchanged gaps up to this long are written over instead of skipped
+#define RENDER_MERGE_GAP 8
 
-static void editorRenderRow(abuf* ab, int row_index) {
-    ScreenCell* row = gEditor.screen[row_index];
+static inline bool isBlankCell(const ScreenCell* cell, Color bg) {
+    return cell->width == 1 && cell->glyph == ' ' &&
+           colorEql(screenGetStyle(cell->style)->bg, bg);
+}
 
-    const ScreenStyle* old_style = NULL;
+// Write the cells from start, which must begin a glyph, until at least end.
+// A blank tail is erased to the end of the line.
+// return: index of the cell after the last one written
+static int editorRenderCells(abuf* ab,
+                             const ScreenCell* row,
+                             int start,
+                             int end,
+                             int* old_style) {
+    int index = start;
+    while (index < end) {
+        const ScreenCell* cell = &row[index];
+        const ScreenStyle* style = screenGetStyle(cell->style);
+
+        if (isBlankCell(cell, style->bg)) {
+            int blank_end = index + 1;
+            while (blank_end < gEditor.screen_cols &&
+                   isBlankCell(&row[blank_end], style->bg)) {
+                blank_end++;
+            }
 
-    gotoXY(ab, row_index + 1, 1);
+            updateStyle(ab, *old_style, cell->style);
+            *old_style = cell->style;
 
-    int index = 0;
-    while (index < gEditor.screen_cols) {
-        ScreenCell* cell = &row[index];
-        Grapheme grapheme = cell->grapheme;
+            if (blank_end == gEditor.screen_cols) {
+                abufAppendStr(ab, ANSI_ERASE_LINE);
+                return blank_end;
+            }
+
+            if (blank_end > end)
+                blank_end = end;
+
+            int count = blank_end - index;
+            if (count >= RENDER_ERASE_MIN) {
+                char buf[32];
+                int len = snprintf(buf, sizeof(buf), "\x1b[%dX\x1b[%dC",
+                                   count, count);
+                abufAppendN(ab, buf, len);
+            } else {
+                for (int i = 0; i < count; i++) {
+                    abufAppendN(ab, " ", 1);
+                }
+            }
+            index = blank_end;
+            continue;
+        }
 
-        updateStyle(ab, old_style, &cell->style);
-        old_style = &cell->style;
+        updateStyle(ab, *old_style, cell->style);
+        *old_style = cell->style;
+
+        // Single code points are stored in the cell
+        const uint32_t* cluster = &cell->glyph;
+        int size = 1;
+        int width = cell->width;
+        if (cell->glyph & SCREEN_GLYPH_CLUSTER) {
+            const Grapheme* grapheme =
+                &screen_table.clusters
+                     .data[cell->glyph & ~SCREEN_GLYPH_CLUSTER];
+            cluster = grapheme->cluster;
+            size = grapheme->size;
+        }
 
-        if (cell->continuation || grapheme.size == 0 || grapheme.width == 0) {
-            // These are not supposed to happen
+        if (width == 0) {
+            // This is not supposed to happen
             // Default to white space
-            grapheme = grapheme_space;
+            static const uint32_t space = ' ';
+            cluster = &space;
+            size = 1;
+            width = 1;
         }
 
         char output[4];
-        int utf8_len = encodeUTF8(grapheme.cluster[0], output);
+        int utf8_len = encodeUTF8(cluster[0], output);
         if (utf8_len == -1) {
             // Replace with the replacement character
-            grapheme.cluster[0] = 0xFFFD;
-            grapheme.size = 1;
-            grapheme.width = 1;
-            utf8_len = encodeUTF8(grapheme.cluster[0], output);
+            size = 1;
+            utf8_len = encodeUTF8(0xFFFD, output);
         }
 
         // Check if this character fits
         bool canDraw = true;
         int offset = 1;
-        while (offset < grapheme.width) {
+        while (offset < width) {
             if (index + offset >= gEditor.screen_cols ||
-                !row[index + offset].continuation) {
+                row[index + offset].width != 0) {
                 canDraw = false;
                 break;
             }
@@ -124,17 +371,155 @@ static void editorRenderRow(abuf* ab, int row_index) {
             }
         } else {
             abufAppendN(ab, output, (size_t)utf8_len);
-            for (int i = 1; i < grapheme.size; i++) {
-                utf8_len = encodeUTF8(grapheme.cluster[i], output);
+            for (int i = 1; i < size; i++) {
+                utf8_len = encodeUTF8(cluster[i], output);
                 if (utf8_len != -1) {
                     abufAppendN(ab, output, (size_t)utf8_len);
                 }
             }
         }
     }
+    return index;
+}
+
+static void editorRenderRow(abuf* ab, int row_index) {
+    int old_style = -1;
+    gotoXY(ab, row_index + 1, 1);
+    editorRenderCells(ab, gEditor.screen[row_index].cells, 0,
+                      gEditor.screen_cols, &old_style);
+}
+
+// Only write the runs of cells that differ from the previous frame
+static void editorRenderRowDiff(abuf* ab, int row_index) {
+    const ScreenCell* row = gEditor.screen[row_index].cells;
+    const ScreenCell* prev_row = gEditor.prev_screen[row_index].cells;
+    const int cols = gEditor.screen_cols;
+
+    int old_style = -1;
+
+    int i = 0;
+    while (i < cols) {
+        if (cellEql(&row[i], &prev_row[i])) {
+            i++;
+            continue;
+        }
+
+        int start = i;
+        int end = i + 1;
+        int gap = 0;
+        for (int j = end; j < cols && gap <= RENDER_MERGE_GAP; j++) {
+            if (cellEql(&row[j], &prev_row[j])) {
+                gap++;
+            } else {
+                end = j + 1;
+                gap = 0;
+            }
+        }
+
+        // Redraw whole glyphs, both the new ones and the ones on the terminal
+        while (start > 0 &&
+               (row[start].width == 0 || prev_row[start].width == 0)) {
+            start--;
+        }
+        while (end < cols &&
+               (row[end].width == 0 || prev_row[end].width == 0)) {
+            end++;
+        }
+
+        gotoXY(ab, row_index + 1, start + 1);
+        i = editorRenderCells(ab, row, start, end, &old_style);
+    }
+}
+
+static void reverseScreenRows(ScreenRow* rows, int start, int end) {
+    for (int i = start, j = end - 1; i < j; i++, j--) {
+        ScreenRow tmp = rows[i];
+        rows[i] = rows[j];
+        rows[j] = tmp;
+    }
+}
+
+// Minimum number of rows a scroll has to save
+#define SCROLL_MIN_ROWS 3
+
+// If the content rows moved up or down as a whole, scroll them on the
+// terminal and shift prev_screen to match, so only new rows are drawn.
+static void editorScrollScreen(abuf* ab) {
+    // Rows between the top and bottom status bar
+    const int top = 1;
+    const int n = gEditor.display_rows;
+    if (n < SCROLL_MIN_ROWS || top + n > gEditor.screen_rows)
+        return;
+
+    const ScreenRow* rows = &gEditor.screen[top];
+    ScreenRow* prev_rows = &gEditor.prev_screen[top];
+
+    int same = 0;
+    for (int i = 0; i < n; i++) {
+        if (rows[i].hash == prev_rows[i].hash)
+            same++;
+    }
+    if (same == n)
+        return;
+
+    // Row i now shows what was at i + shift
+    int shift = 0;
+    int best = same;
+    for (int k = 1 - n; k < n; k++) {
+        if (k == 0)
+            continue;
+        int matches = 0;
+        for (int i = (k < 0) ? -k : 0; i < n && i + k < n; i++) {
+            if (rows[i].hash == prev_rows[i + k].hash)
+                matches++;
+        }
+        if (matches > best) {
+            best = matches;
+            shift = k;
+        }
+    }
+
+    if (shift == 0 || best - same < SCROLL_MIN_ROWS)
+        return;
+
+    int count = shift > 0 ? shift : -shift;
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), "\x1b[%d;%dr\x1b[%d%c", top + 1,
+                       top + n, count, shift > 0 ? 'S' : 'T');
+    // With bce, new rows take the background of the current SGR
+    abufAppendStr(ab, ANSI_CLEAR);
+    abufAppendN(ab, buf, len);
+    abufAppendStr(ab, ANSI_RESET_SCROLL_REGION);
+
+    // Rotate prev_screen the same way, in place
+    int left = (shift % n + n) % n;
+    reverseScreenRows(prev_rows, 0, left);
+    reverseScreenRows(prev_rows, left, n);
+    reverseScreenRows(prev_rows, 0, n);
+
+    // The terminal fills new rows with the default background
+    const ScreenStyle blank_style = {0};
+    const ScreenCell blank = {
+        .glyph = ' ',
+        .style = screenStyleId(&blank_style),
+        .width = 1,
+    };
+    int start = shift > 0 ? n - count : 0;
+    for (int i = start; i < start + count; i++) {
+        for (int j = 0; j < gEditor.screen_cols; j++) {
+            prev_rows[i].cells[j] = blank;
+        }
+        prev_rows[i].hash = screenHashRow(prev_rows[i].cells,
+                                          gEditor.screen_cols);
+    }
+
+    // screen no longer matches prev_screen where it isn't dirty
+    for (int i = 0; i < n; i++) {
+        gEditor.screen[top + i].dirty = true;
+    }
 }
 
-static void screenClearCells(ScreenCell* row,
+static void screenClearCells(ScreenRow* row,
                              int max_width,
                              int x,
                              int count,
@@ -147,17 +532,21 @@ static void screenClearCells(ScreenCell* row,
         to_clear = max_width - x;
     }
 
+    uint16_t style_id = screenStyleId(&style);
     for (int i = 0; i < to_clear; i++) {
-        row[x + i].continuation = false;
-        row[x + i].grapheme = grapheme_space;
-        row[x + i].style = style;
+        screenSetCell(row, x + i,
+                      (ScreenCell){
+                          .glyph = ' ',
+                          .style = style_id,
+                          .width = 1,
+                      });
     }
 }
 
 // Put a grapheme in a cell
 // Marks the cells occupied by the grapheme as continuation
 // Returns the number of cells used (grapheme width)
-static int screenPutGrapheme(ScreenCell* row,
+static int screenPutGrapheme(ScreenRow* row,
                              int max_width,
                              int x,
                              const Grapheme* grapheme,
@@ -169,21 +558,42 @@ static int screenPutGrapheme(ScreenCell* row,
     if (x + width > max_width)
         width = max_width - x;
 
+    uint16_t style_id = screenStyleId(style);
+
     // Set the first cell
-    row[x].continuation = false;
-    row[x].grapheme = *grapheme;
-    row[x].style = *style;
+    screenSetCell(row, x,
+                  (ScreenCell){
+                      .glyph = screenGraphemeGlyph(grapheme),
+                      .style = style_id,
+                      .width = grapheme->width,
+                  });
 
     // Mark continuation cells
     for (int i = 1; i < width; i++) {
-        row[x + i].continuation = true;
-        row[x + i].style = *style;
+        screenSetCell(row, x + i, (ScreenCell){.style = style_id});
     }
 
     return width;
 }
 
-static int screenPutChar(ScreenCell* row,
+// Add a zero-width character to the grapheme in a cell
+static void screenAppendToCell(ScreenRow* row, int x, uint32_t code_point) {
+    ScreenCell cell = row->cells[x];
+    if (cell.width == 0)
+        return;
+
+    Grapheme grapheme;
+    screenCellGrapheme(&cell, &grapheme);
+    if (grapheme.size >= MAX_CLUSTER_SIZE)
+        return;
+
+    grapheme.cluster[grapheme.size] = code_point;
+    grapheme.size++;
+    cell.glyph = screenGraphemeGlyph(&grapheme);
+    screenSetCell(row, x, cell);
+}
+
+static int screenPutChar(ScreenRow* row,
                          int max_width,
                          int x,
                          uint32_t code_point,
@@ -200,7 +610,7 @@ static int screenPutChar(ScreenCell* row,
     return screenPutGrapheme(row, max_width, x, &grapheme, style);
 }
 
-static int screenPutUtf8(ScreenCell* row,
+static int screenPutUtf8(ScreenRow* row,
                          int max_width,
                          int x,
                          const char* s,
@@ -272,7 +682,7 @@ static int screenPutUtf8(ScreenCell* row,
     return x - start_x;
 }
 
-static int screenPutAscii(ScreenCell* row,
+static int screenPutAscii(ScreenRow* row,
                           int max_width,
                           int x,
                           const char* s,
@@ -354,7 +764,7 @@ static void editorDrawTopStatusBar(void) {
         return;
     }
 
-    ScreenCell* row = gEditor.screen[0];
+    ScreenRow* row = &gEditor.screen[0];
     const ScreenStyle default_style = {
         .fg = gEditor.color_cfg[UI_COLOR_TOP_FG],
         .bg = gEditor.color_cfg[UI_COLOR_TOP_BG],
@@ -516,7 +926,7 @@ static void editorDrawConMsg(void) {
 
     int index = gEditor.con_front;
     for (int i = 0; i < gEditor.con_size; i++) {
-        ScreenCell* row = gEditor.screen[draw_row];
+        ScreenRow* row = &gEditor.screen[draw_row];
         screenClearCells(row, gEditor.screen_cols, 0, gEditor.screen_cols,
                          style);
 
@@ -534,8 +944,8 @@ static void editorDrawPrompt(void) {
         return;
     }
 
-    ScreenCell* row =
-        gEditor.screen[gEditor.screen_rows - 2];  // prompt + status bar
+    ScreenRow* row =
+        &gEditor.screen[gEditor.screen_rows - 2];  // prompt + status bar
     ScreenStyle style = {
         .fg = gEditor.color_cfg[UI_COLOR_PROMPT_FG],
         .bg = gEditor.color_cfg[UI_COLOR_PROMPT_BG],
@@ -636,8 +1046,13 @@ static void editorDrawPrompt(void) {
         if (select_end > gEditor.screen_cols)
             select_end = gEditor.screen_cols;
         for (int i = select_start; i < select_end; i++) {
-            if (!row[i].continuation)
-                row[i].style.bg = select_style.bg;
+            ScreenCell cell = row->cells[i];
+            if (cell.width != 0) {
+                ScreenStyle cell_style = *screenGetStyle(cell.style);
+                cell_style.bg = select_style.bg;
+                cell.style = screenStyleId(&cell_style);
+                screenSetCell(row, i, cell);
+            }
         }
     }
 
@@ -648,7 +1063,7 @@ static void editorDrawPrompt(void) {
 }
 
 static void editorDrawStatusBar(void) {
-    ScreenCell* row = gEditor.screen[gEditor.screen_rows - 1];
+    ScreenRow* row = &gEditor.screen[gEditor.screen_rows - 1];
     ScreenStyle default_style = {
         .fg = gEditor.color_cfg[UI_COLOR_STATUS_FG],
         .bg = gEditor.color_cfg[UI_COLOR_STATUS_BG],
@@ -733,6 +1148,54 @@ static void editorDrawStatusBar(void) {
     }
 }
 
+// Timings of the last frame and keystroke to paint latency
+static void editorDrawPerfOverlay(void) {
+    if (!editorPerfEnabled())
+        return;
+
+    const EditorPerfFrame* f = &gEditor.perf.last;
+    int p50, p99;
+    editorPerfGetLatency(&p50, &p99);
+
+    char lines[3][80];
+    snprintf(lines[0], sizeof(lines[0]),
+             "input %.2f  hl %.2f  draw %.2f  diff %.2f  write %.2f ms",
+             f->phase_us[PERF_INPUT] / 1000.0,
+             f->phase_us[PERF_HIGHLIGHT] / 1000.0,
+             f->phase_us[PERF_DRAW] / 1000.0, f->phase_us[PERF_DIFF] / 1000.0,
+             f->phase_us[PERF_WRITE] / 1000.0);
+    snprintf(lines[1], sizeof(lines[1]), "rows %d  bytes %zu  allocs %llu",
+             f->rows_redrawn, f->bytes_written, (unsigned long long)f->allocs);
+    snprintf(lines[2], sizeof(lines[2]), "latency p50 %d ms  p99 %d ms", p50,
+             p99);
+
+    int width = 0;
+    for (int i = 0; i < 3; i++) {
+        int len = (int)strlen(lines[i]);
+        if (len > width)
+            width = len;
+    }
+    width += 2;
+
+    int x = gEditor.screen_cols - width;
+    if (x < 0)
+        x = 0;
+
+    ScreenStyle style = {
+        .fg = gEditor.color_cfg[UI_COLOR_PROMPT_FG],
+        .bg = gEditor.color_cfg[UI_COLOR_PROMPT_BG],
+    };
+    for (int i = 0; i < 3; i++) {
+        int y = i + 1;
+        if (y >= gEditor.screen_rows - 1)
+            break;
+
+        ScreenRow* row = &gEditor.screen[y];
+        screenClearCells(row, gEditor.screen_cols, x, width, style);
+        screenPutAscii(row, gEditor.screen_cols, x + 1, lines[i], style);
+    }
+}
+
 static void editorDrawBackground(void) {
     ScreenStyle style = {
         .fg = gEditor.color_cfg[UI_COLOR_HL_NORMAL],
@@ -740,7 +1203,7 @@ static void editorDrawBackground(void) {
     };
 
     for (int i = 0; i < gEditor.screen_rows; i++) {
-        ScreenCell* row = gEditor.screen[i];
+        ScreenRow* row = &gEditor.screen[i];
         screenClearCells(row, gEditor.screen_cols, 0, gEditor.screen_cols,
                          style);
     }
@@ -817,11 +1280,263 @@ static void editorDrawIntroMessages(void) {
             style = hint_style;
         }
 
-        screenPutUtf8(gEditor.screen[start_row + i], gEditor.screen_cols,
+        screenPutUtf8(&gEditor.screen[start_row + i], gEditor.screen_cols,
                       start_col, line, style);
     }
 }
 
+// Draw the text of file row i from rx_start to rx_end in [x, end), returns the
+// x after the last cell written. A wide character at the end may spill over up
+// to max_width.
+static int editorDrawRowText(ScreenRow* row,
+                             int max_width,
+                             int x,
+                             int end,
+                             const EditorTab* tab,
+                             EditorFile* file,
+                             int i,
+                             const EditorHLEntry* hl,
+                             EditorUIColorType bg_color,
+                             const EditorSelectRange* range,
+                             int rx_start,
+                             int rx_end) {
+    EditorRow* row_data = &file->row[i];
+
+    int col_offset = editorRowRxToCx(row_data, rx_start);
+    int data_len = row_data->size - col_offset;
+    if (data_len < 0) {
+        data_len = 0;
+    }
+
+    int rlen = rx_end - rx_start;
+    if (rlen > end - x) {
+        rlen = end - x;
+    }
+    rlen += rx_start;
+
+    // Highlight spans
+    EditorHLSpanIter hl_iter;
+    EditorHLSpan span = {0};
+    editorHLSpanIterInit(&hl_iter, file, hl);
+    bool has_span = editorHLSpanIterNext(&hl_iter, &span);
+
+    char* c = &row_data->data[col_offset];
+
+    int j = 0;
+    int rx = rx_start;
+    int screen_x = x;
+
+    // Cell that following zero-width characters are added to
+    int curr_x = -1;
+
+    while (rx < rlen && screen_x < end) {
+        uint32_t cx = j + col_offset;
+
+        EditorUIColorType fg = UI_COLOR_HL_NORMAL;
+        EditorUIColorType bg = bg_color;
+
+        // We assume the span is sorted and not overlapping
+        while (has_span && span.start + span.len <= cx) {
+            has_span = editorHLSpanIterNext(&hl_iter, &span);
+        }
+
+        if (has_span && span.start <= cx) {
+            fg = editorHL2UIColor(span.type);
+        }
+
+        if (tab->cursor.is_selected && isPosSelected(i, cx, *range)) {
+            bg = UI_COLOR_HL_SELECT;
+        } else if (tab->has_match && i == tab->match_row &&
+                   cx >= tab->match_col &&
+                   cx < tab->match_col + tab->match_len) {
+            bg = UI_COLOR_HL_MATCH;
+        } else if (row_data->size - hl->trailing_spaces <= cx) {
+            bg = UI_COLOR_HL_TRAILING;
+        }
+
+        ScreenStyle style = {0};
+
+        if (isCntrl(c[j]) && c[j] != '\t') {
+            // Control character (show inverted)
+            style.fg = gEditor.color_cfg[fg];
+            style.bg = gEditor.color_cfg[bg];
+
+            uint32_t sym = (c[j] <= 26) ? '@' + c[j] : '?';
+            Color tmp = style.fg;
+            style.fg = style.bg;
+            style.bg = tmp;
+
+            screen_x += screenPutChar(row, max_width, screen_x, sym, &style);
+            curr_x = -1;
+            rx++;
+            j++;
+        } else {
+            if (drawspace.int_value && (c[j] == ' ' || c[j] == '\t')) {
+                fg = UI_COLOR_HL_SPACE;
+            }
+            if (bg == UI_COLOR_HL_TRAILING && !trailing.int_value) {
+                bg = bg_color;
+            }
+
+            style.fg = gEditor.color_cfg[fg];
+            style.bg = gEditor.color_cfg[bg];
+
+            if (c[j] == '\t') {
+                char tab_char = drawspace.int_value ? '|' : ' ';
+                screen_x += screenPutChar(row, max_width, screen_x, tab_char,
+                                          &style);
+                rx++;
+                while (rx % tabsize.int_value != 0 && rx < rlen &&
+                       screen_x < end) {
+                    screen_x += screenPutChar(row, max_width, screen_x, ' ',
+                                              &style);
+                    rx++;
+                }
+                curr_x = -1;
+                j++;
+            } else if (c[j] == ' ') {
+                char space_char = drawspace.int_value ? '.' : ' ';
+                screen_x += screenPutChar(row, max_width, screen_x, space_char,
+                                          &style);
+                curr_x = -1;
+                rx++;
+                j++;
+            } else {
+                size_t byte_size;
+                uint32_t unicode = decodeUTF8(&c[j], data_len - j, &byte_size);
+                int width = unicodeWidth(unicode);
+                if (width < 0) {
+                    unicode = 0xFFFD;
+                    width = 1;
+                }
+
+                if (width == 0) {
+                    if (curr_x >= 0)
+                        screenAppendToCell(row, curr_x, unicode);
+                } else {
+                    curr_x = screen_x;
+                    screen_x += screenPutChar(row, max_width, screen_x, unicode,
+                                              &style);
+                    rx += width;
+                }
+                j += byte_size;
+            }
+        }
+
+        // Gather trailing zero-width characters
+        while (data_len - j > 0) {
+            size_t byte_size;
+            uint32_t unicode = decodeUTF8(&c[j], data_len - j, &byte_size);
+            int width = unicodeWidth(unicode);
+            if (width != 0)
+                break;
+            if (curr_x >= 0)
+                screenAppendToCell(row, curr_x, unicode);
+            j += byte_size;
+        }
+    }
+
+    return screen_x;
+}
+
+// Rasterized text of a file row. It's reused as long as the row content,
+// its highlight, the viewport and the style epoch are the same.
+typedef struct RowRaster {
+    uint32_t version;  // 0 if empty
+    uint32_t hl_entry;
+    uint32_t hl_gen;
+    uint32_t epoch;
+    int rx_start;
+    int rx_end;
+    int cols;
+    int max_width;
+    bool cursor_line;
+
+    ScreenRow row;  // Cells relative to the start of the text
+    int width;
+} RowRaster;
+
+// Direct mapped by row version and visual line, one table per split
+static struct {
+    RowRaster* entries;
+    int capacity;
+} row_rasters[EDITOR_SPLIT_MAX];
+
+static void editorFreeRowRasters(void) {
+    for (int i = 0; i < EDITOR_SPLIT_MAX; i++) {
+        for (int j = 0; j < row_rasters[i].capacity; j++) {
+            free(row_rasters[i].entries[j].row.cells);
+        }
+        free(row_rasters[i].entries);
+        row_rasters[i].entries = NULL;
+        row_rasters[i].capacity = 0;
+    }
+}
+
+static void editorDrawRowTextCached(int split_index,
+                                    int line,
+                                    ScreenRow* row,
+                                    int x,
+                                    int end,
+                                    const EditorTab* tab,
+                                    EditorFile* file,
+                                    int i,
+                                    const EditorHLEntry* hl,
+                                    EditorUIColorType bg_color,
+                                    const EditorSelectRange* range,
+                                    int rx_start,
+                                    int rx_end) {
+    const EditorRow* row_data = &file->row[i];
+    int cols = end - x;
+    int max_width = gEditor.screen_cols - x;
+    bool cursor_line = (bg_color == UI_COLOR_CURSORLINE);
+    if (cols <= 0)
+        return;
+
+    if (!row_rasters[split_index].entries) {
+        int capacity = 16;
+        while (capacity < gEditor.display_rows * 2) {
+            capacity *= 2;
+        }
+        row_rasters[split_index].entries =
+            calloc_s(capacity, sizeof(RowRaster));
+        row_rasters[split_index].capacity = capacity;
+    }
+
+    uint32_t key = row_data->version ^ ((uint32_t)line * 0x9E3779B9u);
+    int slot = key & (row_rasters[split_index].capacity - 1);
+    RowRaster* raster = &row_rasters[split_index].entries[slot];
+
+    if (raster->version != row_data->version ||
+        raster->hl_entry != row_data->hl_entry ||
+        raster->hl_gen != row_data->hl_gen || raster->epoch != style_epoch ||
+        raster->rx_start != rx_start || raster->rx_end != rx_end ||
+        raster->cols != cols ||
+        raster->max_width != max_width || raster->cursor_line != cursor_line) {
+        if (!raster->row.cells) {
+            raster->row.cells =
+                calloc_s(gEditor.screen_cols, sizeof(ScreenCell));
+        }
+
+        raster->width =
+            editorDrawRowText(&raster->row, max_width, 0, cols, tab, file, i,
+                              hl, bg_color, range, rx_start, rx_end);
+        raster->version = row_data->version;
+        raster->hl_entry = row_data->hl_entry;
+        raster->hl_gen = row_data->hl_gen;
+        raster->epoch = style_epoch;
+        raster->rx_start = rx_start;
+        raster->rx_end = rx_end;
+        raster->cols = cols;
+        raster->max_width = max_width;
+        raster->cursor_line = cursor_line;
+    }
+
+    for (int j = 0; j < raster->width; j++) {
+        screenSetCell(row, x + j, raster->row.cells[j]);
+    }
+}
+
 static void editorDrawSplit(int split_index) {
     if (gEditor.explorer.width >= gEditor.screen_cols) {
         return;
@@ -841,9 +1556,19 @@ static void editorDrawSplit(int split_index) {
     int content_start_col = start + lineno_width;
     int content_cols = end - content_start_col;
 
-    for (int i = tab->row_offset, s_row = 1;
-         i < tab->row_offset + gEditor.display_rows; i++, s_row++) {
-        ScreenCell* row = gEditor.screen[s_row];
+    // Visual line to draw, sub is the line inside row i when wrapping
+    EditorWrapLayout* layout = editorGetSplitWrap(split_index);
+    int i = tab->row_offset;
+    int sub = 0;
+    if (layout)
+        i = editorWrapRowOfLine(layout, editorWrapGetTop(layout, tab), &sub);
+
+    EditorWrapIter wrap_iter;
+    int wrap_row = -1;
+
+    for (int s_row = 1; s_row <= gEditor.display_rows; s_row++) {
+        ScreenRow* row = &gEditor.screen[s_row];
+        bool last_line = true;
 
         // Clear the entire row
         EditorUIColorType bg_color =
@@ -870,183 +1595,69 @@ static void editorDrawSplit(int split_index) {
                                       : gEditor.color_cfg[UI_COLOR_LINENO_BG];
 
                 char line_number[16];
-                snprintf(line_number, sizeof(line_number), " %*d ",
-                         file->lineno_width - 2, i + 1);
+                if (sub == 0) {
+                    snprintf(line_number, sizeof(line_number), " %*d ",
+                             file->lineno_width - 2, i + 1);
+                } else {
+                    snprintf(line_number, sizeof(line_number), " %*s ",
+                             file->lineno_width - 2, "");
+                }
                 x += screenPutAscii(row, gEditor.screen_cols, x, line_number,
                                     lineno_style);
             }
 
             EditorRow* row_data = &file->row[i];
-            if (!row_data->hl_updated) {
-                // Do full single line syntax update
-                editorUpdateSyntax(file, row_data, HL_UPDATE_SINGLE_LINE);
-            }
-
-            // Draw content
-            int col_offset = editorRowRxToCx(row_data, tab->col_offset);
-            int data_len = row_data->size - col_offset;
-            if (data_len < 0) {
-                data_len = 0;
-            }
-
-            int rlen = row_data->rsize - tab->col_offset;
-            if (rlen > content_cols) {
-                rlen = content_cols;
-            }
-            rlen += tab->col_offset;
-
-            // Highlight span index
-            uint32_t hls_index = 0;
-            const EditorHLSpanVector hl_spans = row_data->hl_spans;
-
-            char* c = &row_data->data[col_offset];
-
-            int j = 0;
-            int rx = tab->col_offset;
-            int screen_x = content_start_col;
-
-            Grapheme* curr_grapheme = NULL;
-
-            while (rx < rlen && screen_x < end) {
-                uint32_t cx = j + col_offset;
-
-                EditorUIColorType fg = UI_COLOR_HL_NORMAL;
-                EditorUIColorType bg = bg_color;
-
-                // We assume the span is sorted and not overlapping
-                while (hls_index < hl_spans.size &&
-                       hl_spans.data[hls_index].start +
-                               hl_spans.data[hls_index].len <=
-                           cx) {
-                    hls_index++;
-                }
-
-                if (hls_index < hl_spans.size) {
-                    const EditorHLSpan* span = &hl_spans.data[hls_index];
-                    uint32_t span_start = span->start;
-                    uint32_t span_end = span->start + span->len;
-                    if (span_start <= cx && cx < span_end) {
-                        EditorUIColorType hl_color =
-                            editorHL2UIColor(span->type);
-                        fg = hl_color;
-                    }
-                }
-
-                if (tab->cursor.is_selected && isPosSelected(i, cx, range)) {
-                    bg = UI_COLOR_HL_SELECT;
-                } else if (tab->has_match && i == tab->match_row &&
-                           cx >= tab->match_col &&
-                           cx < tab->match_col + tab->match_len) {
-                    bg = UI_COLOR_HL_MATCH;
-                } else if (row_data->size - row_data->trailing_spaces <= cx) {
-                    bg = UI_COLOR_HL_TRAILING;
-                }
-
-                ScreenStyle style = {0};
-
-                if (isCntrl(c[j]) && c[j] != '\t') {
-                    // Control character (show inverted)
-                    style.fg = gEditor.color_cfg[fg];
-                    style.bg = gEditor.color_cfg[bg];
-
-                    uint32_t sym = (c[j] <= 26) ? '@' + c[j] : '?';
-                    Color tmp = style.fg;
-                    style.fg = style.bg;
-                    style.bg = tmp;
-
-                    screen_x += screenPutChar(row, gEditor.screen_cols,
-                                              screen_x, sym, &style);
-                    curr_grapheme = NULL;
-                    rx++;
-                    j++;
-                } else {
-                    if (drawspace.int_value && (c[j] == ' ' || c[j] == '\t')) {
-                        fg = UI_COLOR_HL_SPACE;
-                    }
-                    if (bg == UI_COLOR_HL_TRAILING && !trailing.int_value) {
-                        bg = bg_color;
-                    }
-
-                    style.fg = gEditor.color_cfg[fg];
-                    style.bg = gEditor.color_cfg[bg];
-
-                    if (c[j] == '\t') {
-                        char tab_char = drawspace.int_value ? '|' : ' ';
-                        screen_x += screenPutChar(row, gEditor.screen_cols,
-                                                  screen_x, tab_char, &style);
-                        rx++;
-                        while (rx % tabsize.int_value != 0 && rx < rlen &&
-                               screen_x < end) {
-                            screen_x += screenPutChar(row, gEditor.screen_cols,
-                                                      screen_x, ' ', &style);
-                            rx++;
-                        }
-                        curr_grapheme = NULL;
-                        j++;
-                    } else if (c[j] == ' ') {
-                        char space_char = drawspace.int_value ? '.' : ' ';
-                        screen_x += screenPutChar(row, gEditor.screen_cols,
-                                                  screen_x, space_char, &style);
-                        curr_grapheme = NULL;
-                        rx++;
-                        j++;
-                    } else {
-                        size_t byte_size;
-                        uint32_t unicode =
-                            decodeUTF8(&c[j], data_len - j, &byte_size);
-                        int width = unicodeWidth(unicode);
-                        if (width < 0) {
-                            unicode = 0xFFFD;
-                            width = 1;
-                        }
-
-                        if (width == 0) {
-                            if (curr_grapheme &&
-                                curr_grapheme->size < MAX_CLUSTER_SIZE) {
-                                curr_grapheme->cluster[curr_grapheme->size] =
-                                    unicode;
-                                curr_grapheme->size++;
-                            }
-                        } else {
-                            curr_grapheme = &row[screen_x].grapheme;
-                            screen_x +=
-                                screenPutChar(row, gEditor.screen_cols,
-                                              screen_x, unicode, &style);
-                            rx += width;
-                        }
-                        j += byte_size;
+            const EditorHLEntry* hl = editorGetRowHL(file, row_data);
+
+            int rx_start = tab->col_offset;
+            int rx_end = row_data->rsize;
+            if (layout) {
+                if (wrap_row != i) {
+                    editorWrapIterInit(&wrap_iter, row_data, layout->width);
+                    for (int k = 0; k < sub; k++) {
+                        editorWrapIterNext(&wrap_iter);
                     }
+                    wrap_row = i;
                 }
+                rx_start = wrap_iter.line_start;
+                last_line = !editorWrapIterNext(&wrap_iter);
+                if (!last_line)
+                    rx_end = wrap_iter.line_start;
+            }
 
-                // Gather trailing zero-width characters
-                while (data_len - j > 0) {
-                    size_t byte_size;
-                    uint32_t unicode =
-                        decodeUTF8(&c[j], data_len - j, &byte_size);
-                    int width = unicodeWidth(unicode);
-                    if (width != 0)
-                        break;
-                    if (curr_grapheme &&
-                        curr_grapheme->size < MAX_CLUSTER_SIZE) {
-                        curr_grapheme->cluster[curr_grapheme->size] = unicode;
-                        curr_grapheme->size++;
-                    }
-                    j += byte_size;
+            // Rows touched by the selection or the match are drawn directly
+            bool selected = tab->cursor.is_selected && i >= range.start_y &&
+                            i <= range.end_y;
+            bool matched = tab->has_match && i == tab->match_row;
+            if (!selected && !matched) {
+                editorDrawRowTextCached(split_index, sub, row,
+                                        content_start_col, end, tab, file, i,
+                                        hl, bg_color, &range, rx_start, rx_end);
+            } else {
+                int screen_x = editorDrawRowText(
+                    row, gEditor.screen_cols, content_start_col, end, tab, file,
+                    i, hl, bg_color, &range, rx_start, rx_end);
+
+                // Add newline character when selected
+                if (tab->cursor.is_selected && range.end_y > i &&
+                    i >= range.start_y && last_line &&
+                    row_data->rsize - rx_start < content_cols &&
+                    screen_x < end) {
+                    ScreenStyle select_style = {
+                        .fg = gEditor.color_cfg[UI_COLOR_HL_NORMAL],
+                        .bg = gEditor.color_cfg[UI_COLOR_HL_SELECT],
+                    };
+                    screenPutChar(row, gEditor.screen_cols, screen_x, ' ',
+                                  &select_style);
                 }
             }
+        }
 
-            // Add newline character when selected
-            if (tab->cursor.is_selected && range.end_y > i &&
-                i >= range.start_y &&
-                row_data->rsize - tab->col_offset < content_cols &&
-                screen_x < end) {
-                ScreenStyle select_style = {
-                    .fg = gEditor.color_cfg[UI_COLOR_HL_NORMAL],
-                    .bg = gEditor.color_cfg[UI_COLOR_HL_SELECT],
-                };
-                screenPutChar(row, gEditor.screen_cols, screen_x, ' ',
-                              &select_style);
-            }
+        if (last_line) {
+            i++;
+            sub = 0;
+        } else {
+            sub++;
         }
     }
 }
@@ -1062,7 +1673,7 @@ static void editorDrawFileExplorer(void) {
     }
 
     // Draw header
-    ScreenCell* header_row = gEditor.screen[0];
+    ScreenRow* header_row = &gEditor.screen[0];
     ScreenStyle header_style = {
         .fg = gEditor.color_cfg[UI_COLOR_EXPLORER_FILE],
         .bg = (gEditor.state == STATE_EXPLORER)
@@ -1091,7 +1702,7 @@ static void editorDrawFileExplorer(void) {
     };
 
     for (int i = 0; i < lines; i++) {
-        ScreenCell* row = gEditor.screen[i + 1];  // Row 1 to display_rows+1
+        ScreenRow* row = &gEditor.screen[i + 1];  // Row 1 to display_rows+1
         int index = gEditor.explorer.offset + i;
         EditorExplorerNode* node = gEditor.explorer.flatten.data[index];
 
@@ -1118,7 +1729,7 @@ static void editorDrawFileExplorer(void) {
 
     // Draw blank lines
     for (int i = 0; i < gEditor.display_rows - lines; i++) {
-        ScreenCell* row = gEditor.screen[lines + i + 1];
+        ScreenRow* row = &gEditor.screen[lines + i + 1];
         screenClearCells(row, gEditor.screen_cols, 0, explorer_width,
                          default_style);
     }
@@ -1142,22 +1753,26 @@ static void editorDrawSplitSeparators(void) {
             continue;
 
         for (int r = 0; r < gEditor.screen_rows - 1; r++) {
-            ScreenCell* row = gEditor.screen[r];
+            ScreenRow* row = &gEditor.screen[r];
             screenPutChar(row, gEditor.screen_cols, sep_col, '|', &style);
         }
     }
 }
 
 void editorFreeScreen(int screen_rows) {
+    screenResetTables();
+    editorFreeRowRasters();
+    abufFree(&frame);
+
     if (gEditor.screen) {
         for (int i = 0; i < screen_rows; i++) {
-            free(gEditor.screen[i]);
+            free(gEditor.screen[i].cells);
         }
         free(gEditor.screen);
     }
     if (gEditor.prev_screen) {
         for (int i = 0; i < screen_rows; i++) {
-            free(gEditor.prev_screen[i]);
+            free(gEditor.prev_screen[i].cells);
         }
         free(gEditor.prev_screen);
     }
@@ -1167,21 +1782,37 @@ void editorRefreshScreen(void) {
     if (gEditor.screen_size_updated) {
         editorFreeScreen(gEditor.old_screen_rows);
 
-        gEditor.screen = malloc_s(gEditor.screen_rows * sizeof(ScreenCell*));
-        for (int i = 0; i < gEditor.screen_rows; i++) {
-            gEditor.screen[i] =
-                malloc_s(gEditor.screen_cols * sizeof(ScreenCell));
-        }
+        gEditor.screen = malloc_s(gEditor.screen_rows * sizeof(ScreenRow));
         gEditor.prev_screen =
-            malloc_s(gEditor.screen_rows * sizeof(ScreenCell*));
+            malloc_s(gEditor.screen_rows * sizeof(ScreenRow));
         for (int i = 0; i < gEditor.screen_rows; i++) {
-            gEditor.prev_screen[i] =
-                malloc_s(gEditor.screen_cols * sizeof(ScreenCell));
+            ScreenCell* cells =
+                calloc_s(gEditor.screen_cols, sizeof(ScreenCell));
+            uint64_t hash = screenHashRow(cells, gEditor.screen_cols);
+            gEditor.screen[i] = (ScreenRow){.cells = cells, .hash = hash};
+
+            cells = calloc_s(gEditor.screen_cols, sizeof(ScreenCell));
+            gEditor.prev_screen[i] = (ScreenRow){.cells = cells, .hash = hash};
         }
     }
 
-    abuf ab = ABUF_INIT;
+    // Ids in prev_screen are lost with the tables
+    bool redraw = gEditor.screen_size_updated;
+    if (screen_table.styles.size > SCREEN_TABLE_MAX ||
+        screen_table.clusters.size > SCREEN_TABLE_MAX) {
+        screenResetTables();
+        redraw = true;
+    }
+    screenUpdateStyleEpoch();
+
+    EditorPerfPhase phase = editorPerfEnter(PERF_DRAW);
 
+    // Reuse the previous frame's allocation
+    abuf ab = frame;
+    ab.len = 0;
+
+    if (gEditor.sync_output)
+        abufAppendStr(&ab, ANSI_SYNC_BEGIN);
     abufAppendStr(&ab, ANSI_CURSOR_HIDE ANSI_CURSOR_RESET_POS);
 
     const EditorTab* tab = editorGetActiveTab();
@@ -1213,14 +1844,34 @@ void editorRefreshScreen(void) {
     editorDrawPrompt();
 
     editorDrawStatusBar();
+    editorDrawPerfOverlay();
+
+    editorPerfEnter(PERF_DIFF);
+
+    if (!redraw)
+        editorScrollScreen(&ab);
 
     // Render sreen
+    int rows_redrawn = 0;
     for (int i = 0; i < gEditor.screen_rows; i++) {
-        if (gEditor.screen_size_updated || editorScreenRowUpdated(i)) {
+        bool updated = redraw;
+        if (updated) {
             editorRenderRow(&ab, i);
-            // Save current screen
-            memcpy(gEditor.prev_screen[i], gEditor.screen[i],
-                   sizeof(ScreenCell) * gEditor.screen_cols);
+        } else if (editorScreenRowUpdated(i)) {
+            editorRenderRowDiff(&ab, i);
+            updated = true;
+        }
+
+        if (updated) {
+            // Keep the current screen, the old one gets drawn over next frame
+            // and can only be compared by hash until then.
+            ScreenRow tmp = gEditor.prev_screen[i];
+            gEditor.prev_screen[i] = gEditor.screen[i];
+            gEditor.screen[i] = tmp;
+            gEditor.screen[i].dirty = true;
+            rows_redrawn++;
+        } else {
+            gEditor.screen[i].dirty = false;
         }
     }
     gEditor.screen_size_updated = false;
@@ -1233,11 +1884,25 @@ void editorRefreshScreen(void) {
             editorGetSplitScreenCols(gEditor.split_active_index, &split_start,
                                      &split_end);
 
+            const EditorRow* cursor_row = &file->row[tab->cursor.y];
+            int rx = editorRowCxToRx(cursor_row, tab->cursor.x);
             int row = (tab->cursor.y - tab->row_offset) + 2;
-            int col =
-                (editorRowCxToRx(&file->row[tab->cursor.y], tab->cursor.x) -
-                 tab->col_offset) +
-                1 + editorGetLinenoWidth(file);
+            int col = (rx - tab->col_offset) + 1 + editorGetLinenoWidth(file);
+
+            EditorWrapLayout* layout =
+                editorGetSplitWrap(gEditor.split_active_index);
+            if (layout) {
+                int sub = editorRowWrapLine(cursor_row, layout->width, rx);
+                int line = editorWrapLineOfRow(layout, tab->cursor.y) + sub;
+                row = (line - editorWrapGetTop(layout, tab)) + 2;
+
+                // Keep the cursor after a full line on its last column
+                int wrap_x =
+                    rx - editorRowWrapStart(cursor_row, layout->width, sub);
+                if (wrap_x >= layout->width)
+                    wrap_x = layout->width - 1;
+                col = wrap_x + 1 + editorGetLinenoWidth(file);
+            }
             if (row <= 1 || row > gEditor.screen_rows - 1 || col <= 0 ||
                 col > split_end - split_start ||
                 row >= gEditor.screen_rows - gEditor.con_size) {
@@ -1266,7 +1931,16 @@ void editorRefreshScreen(void) {
     }
 
     abufAppendStr(&ab, ANSI_CLEAR);
+    if (gEditor.sync_output)
+        abufAppendStr(&ab, ANSI_SYNC_END);
 
+    editorPerfEnter(PERF_WRITE);
     writeConsoleAll(ab.buf, ab.len);
-    abufFree(&ab);
+    editorPerfLeave(phase);
+    editorPerfFrameEnd(rows_redrawn, ab.len);
+
+    // Drop the buffer after a large frame so it doesn't stay pinned
+    if (ab.capacity > FRAME_KEEP_MIN && ab.capacity > ab.len * 4)
+        abufFree(&ab);
+    frame = ab;
 }
@@ -15,12 +15,22 @@ typedef struct ScreenStyle {
     Color fg;
 } ScreenStyle;
 
+// Set in ScreenCell.glyph when it is an index into the grapheme table
+#define SCREEN_GLYPH_CLUSTER 0x80000000u
+
 typedef struct ScreenCell {
-    bool continuation;  // Is continuation of a previous cell
-    Grapheme grapheme;
-    ScreenStyle style;
+    uint32_t glyph;  // Code point, or SCREEN_GLYPH_CLUSTER | cluster index
+    uint16_t style;  // Index into the style table
+    uint8_t width;   // 0 if continuation of a previous cell
+    uint8_t reserved;
 } ScreenCell;
 
+typedef struct ScreenRow {
+    ScreenCell* cells;
+    uint64_t hash;  // Sum of the cell hashes, updated on every write
+    bool dirty;     // A cell changed since the row was last rendered
+} ScreenRow;
+
 void editorRefreshScreen(void);
 void editorGetSplitScreenCols(int split_index, int* left_cols, int* right_cols);
 void editorFreeScreen(int screen_rows);
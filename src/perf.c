@@ -0,0 +1,91 @@
+#include "perf.h"
+
+#include "config.h"
+#include "editor.h"
+#include "os.h"
+
+bool editorPerfEnabled(void) {
+    return developer.int_value >= PERF_DEVELOPER_LEVEL;
+}
+
+EditorPerfPhase editorPerfEnter(EditorPerfPhase phase) {
+    EditorPerf* perf = &gEditor.perf;
+    EditorPerfPhase prev = perf->phase;
+    if (phase == prev)
+        return prev;
+
+    perf->phase = phase;
+    if (!editorPerfEnabled()) {
+        perf->phase_start = 0;
+        return prev;
+    }
+
+    int64_t now = getTimeUs();
+    if (prev != PERF_IDLE && perf->phase_start)
+        perf->curr.phase_us[prev] += now - perf->phase_start;
+    perf->phase_start = now;
+    return prev;
+}
+
+void editorPerfLeave(EditorPerfPhase prev) {
+    editorPerfEnter(prev);
+}
+
+void editorPerfInput(int64_t timestamp_ms) {
+    EditorPerf* perf = &gEditor.perf;
+    if (perf->input_ms == 0 || timestamp_ms < perf->input_ms)
+        perf->input_ms = timestamp_ms;
+}
+
+void editorPerfFrameEnd(int rows_redrawn, size_t bytes_written) {
+    EditorPerf* perf = &gEditor.perf;
+    if (!editorPerfEnabled()) {
+        perf->input_ms = 0;
+        perf->frame_allocs = alloc_count;
+        return;
+    }
+
+    // Close the running phase so it's counted in this frame
+    EditorPerfPhase phase = perf->phase;
+    editorPerfEnter(PERF_IDLE);
+
+    perf->curr.rows_redrawn = rows_redrawn;
+    perf->curr.bytes_written = bytes_written;
+    perf->curr.allocs = alloc_count - perf->frame_allocs;
+    perf->last = perf->curr;
+    memset(&perf->curr, 0, sizeof(perf->curr));
+    perf->frame_allocs = alloc_count;
+
+    if (perf->input_ms) {
+        int latency = (int)(getTimeMs() - perf->input_ms);
+        perf->latency_ms[perf->latency_next] = latency;
+        perf->latency_next = (perf->latency_next + 1) % PERF_LATENCY_SAMPLES;
+        if (perf->latency_count < PERF_LATENCY_SAMPLES)
+            perf->latency_count++;
+        perf->input_ms = 0;
+    }
+
+    editorPerfEnter(phase);
+}
+
+static int compareInt(const void* a, const void* b) {
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+void editorPerfGetLatency(int* p50, int* p99) {
+    const EditorPerf* perf = &gEditor.perf;
+    int count = perf->latency_count;
+    if (count == 0) {
+        *p50 = 0;
+        *p99 = 0;
+        return;
+    }
+
+    int sorted[PERF_LATENCY_SAMPLES];
+    memcpy(sorted, perf->latency_ms, sizeof(int) * count);
+    qsort(sorted, count, sizeof(int), compareInt);
+    *p50 = sorted[(count - 1) / 2];
+    *p99 = sorted[(count - 1) * 99 / 100];
+}
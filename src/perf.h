@@ -0,0 +1,55 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include "utils.h"
+
+// Frame timings for the developer overlay, only collected when developer is
+// at least PERF_DEVELOPER_LEVEL.
+#define PERF_DEVELOPER_LEVEL 2
+#define PERF_LATENCY_SAMPLES 128
+
+typedef enum EditorPerfPhase {
+    PERF_IDLE = 0,  // Not counted
+    PERF_INPUT,
+    PERF_HIGHLIGHT,
+    PERF_DRAW,
+    PERF_DIFF,
+    PERF_WRITE,
+
+    PERF_PHASE_COUNT,
+} EditorPerfPhase;
+
+typedef struct EditorPerfFrame {
+    int64_t phase_us[PERF_PHASE_COUNT];
+    int rows_redrawn;
+    size_t bytes_written;
+    uint64_t allocs;
+} EditorPerfFrame;
+
+typedef struct EditorPerf {
+    EditorPerfPhase phase;
+    int64_t phase_start;
+
+    EditorPerfFrame curr;
+    EditorPerfFrame last;
+    uint64_t frame_allocs;  // alloc_count when the frame started
+
+    // Oldest input not painted yet, 0 if none
+    int64_t input_ms;
+    // Keystroke to paint latency ring
+    int latency_ms[PERF_LATENCY_SAMPLES];
+    int latency_count;
+    int latency_next;
+} EditorPerf;
+
+bool editorPerfEnabled(void);
+// Switch to a phase, returns the previous one to pass to editorPerfLeave
+EditorPerfPhase editorPerfEnter(EditorPerfPhase phase);
+void editorPerfLeave(EditorPerfPhase prev);
+
+void editorPerfInput(int64_t timestamp_ms);
+// Called after a frame is written
+void editorPerfFrameEnd(int rows_redrawn, size_t bytes_written);
+void editorPerfGetLatency(int* p50, int* p99);
+
+#endif
@@ -30,11 +30,22 @@ void editorRowEnsureCapacity(EditorRow* row, size_t size) {
     row->capacity = new_capacity;
 }
 
+static uint32_t editorRowNextVersion(void) {
+    static uint32_t row_version = 0;
+    // 0 is never used so it can mark an empty slot
+    if (++row_version == 0)
+        row_version++;
+    return row_version;
+}
+
 void editorUpdateRow(EditorFile* file, EditorRow* row) {
+    row->version = editorRowNextVersion();
+
     row->rsize = editorRowCxToRx(row, row->size);
     if (file) {
         // When doing prompt editing, file can be NULL.
         editorUpdateSyntax(file, row, HL_UPDATE_LAZY);
+        editorWrapUpdateRow(file, (int)(row - file->row));
     }
 }
 
@@ -45,6 +56,7 @@ void editorInsertRow(EditorFile* file, int at, const char* s, size_t len) {
     size_t new_capacity;
     if (ensureCapacity(file->row_capacity, file->num_rows + 1, &new_capacity)) {
         file->row = realloc_s(file->row, sizeof(EditorRow) * new_capacity);
+        file->row_capacity = new_capacity;
     }
 
     memmove(&file->row[at + 1], &file->row[at],
@@ -53,13 +65,58 @@ void editorInsertRow(EditorFile* file, int at, const char* s, size_t len) {
 
     file->num_rows++;
     file->lineno_width = getDigit(file->num_rows) + 2;
+    editorWrapInsertRows(file, at, 1);
 
     editorRowAppendString(file, &file->row[at], s, len);
 }
 
+void editorInsertRows(EditorFile* file,
+                      int at,
+                      Str* lines,
+                      int count,
+                      bool take) {
+    if (at < 0 || at > file->num_rows || count <= 0)
+        return;
+
+    size_t new_capacity;
+    if (ensureCapacity(file->row_capacity, file->num_rows + count,
+                       &new_capacity)) {
+        file->row = realloc_s(file->row, sizeof(EditorRow) * new_capacity);
+        file->row_capacity = new_capacity;
+    }
+
+    memmove(&file->row[at + count], &file->row[at],
+            sizeof(EditorRow) * (file->num_rows - at));
+    memset(&file->row[at], 0, sizeof(EditorRow) * count);
+
+    file->num_rows += count;
+    file->lineno_width = getDigit(file->num_rows) + 2;
+    editorWrapInsertRows(file, at, count);
+
+    for (int i = 0; i < count; i++) {
+        EditorRow* row = &file->row[at + i];
+        Str* line = &lines[i];
+        if (take) {
+            row->data = line->data;
+            row->capacity = line->data ? line->size : 0;
+            line->data = NULL;
+        } else if (line->size > 0) {
+            row->data = malloc_s(line->size);
+            row->capacity = line->size;
+            memcpy(row->data, line->data, line->size);
+        }
+        row->size = line->size;
+
+        row->version = editorRowNextVersion();
+        row->rsize = editorRowCxToRx(row, row->size);
+        editorWrapUpdateRow(file, at + i);
+    }
+
+    editorUpdateSyntaxRange(file, &file->row[at], count, HL_UPDATE_LAZY);
+}
+
 void editorFreeRow(EditorRow* row) {
     free(row->data);
-    vector_free(row->hl_spans);
 }
 
 void editorDelRow(EditorFile* file, int at) {
@@ -71,6 +128,7 @@ void editorDelRow(EditorFile* file, int at) {
 
     file->num_rows--;
     file->lineno_width = getDigit(file->num_rows) + 2;
+    editorWrapDeleteRows(file, at, 1);
 
     if (at < file->num_rows) {
         editorUpdateRow(file, &file->row[at]);
@@ -6,24 +6,31 @@
 
 typedef struct EditorFile EditorFile;
 
-typedef VECTOR(EditorHLSpan) EditorHLSpanVector;
-
 typedef struct EditorRow {
     int size;
     int rsize;
     char* data;
     size_t capacity;
 
+    // Changes whenever the content does, unique across all rows
+    uint32_t version;
+
     // Highlighting attribute
-    EditorHLSpanVector hl_spans;
-    uint32_t trailing_spaces;
+    uint32_t hl_entry;  // Spans in file->hl_cache
+    uint32_t hl_gen;
     bool hl_open_comment;
-    bool hl_updated;
 } EditorRow;
 
 void editorRowEnsureCapacity(EditorRow* row, size_t size);
 void editorUpdateRow(EditorFile* file, EditorRow* row);
 void editorInsertRow(EditorFile* file, int at, const char* s, size_t len);
+// Insert count rows at once. With take, the rows own the line buffers and the
+// line data is set to NULL, otherwise the lines are copied.
+void editorInsertRows(EditorFile* file,
+                      int at,
+                      Str* lines,
+                      int count,
+                      bool take);
 void editorFreeRow(EditorRow* row);
 void editorDelRow(EditorFile* file, int at);
 void editorRowInsertChar(EditorFile* file, EditorRow* row, int at, int c);
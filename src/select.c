@@ -111,6 +111,7 @@ void editorDeleteText(EditorFile* file, EditorSelectRange range) {
 
     file->num_rows -= removed_rows;
     file->lineno_width = getDigit(file->num_rows) + 2;
+    editorWrapDeleteRows(file, range.start_y + 1, removed_rows);
 
     if (range.start_y + 1 < file->num_rows) {
         editorUpdateRow(file, &file->row[range.start_y + 1]);
@@ -201,10 +202,55 @@ void editorCopyLine(EditorFile* file, EditorClipboard* clipboard, int row) {
     clipboard->lines[1].data = NULL;
 }
 
-void editorPasteText(EditorFile* file,
-                     const EditorClipboard* clipboard,
-                     int x,
-                     int y) {
+void editorDetachText(EditorFile* file,
+                      EditorClipboard* clipboard,
+                      EditorSelectRange range) {
+    editorFreeClipboardContent(clipboard);
+    if (range.start_y == range.end_y) {
+        editorCopyText(file, clipboard, range);
+        editorDeleteText(file, range);
+        return;
+    }
+
+    clipboard->size = range.end_y - range.start_y + 1;
+    clipboard->lines = malloc_s(sizeof(Str) * clipboard->size);
+
+    // First and last lines are partial
+    const EditorRow* first = &file->row[range.start_y];
+    Str* line = &clipboard->lines[0];
+    line->size = first->size - range.start_x;
+    line->data = NULL;
+    if (line->size > 0) {
+        line->data = malloc_s(line->size);
+        memcpy(line->data, &first->data[range.start_x], line->size);
+    }
+
+    for (int i = range.start_y + 1; i < range.end_y; i++) {
+        EditorRow* row = &file->row[i];
+        line = &clipboard->lines[i - range.start_y];
+        line->data = row->data;
+        line->size = row->size;
+        row->data = NULL;
+        row->size = 0;
+    }
+
+    const EditorRow* last = &file->row[range.end_y];
+    line = &clipboard->lines[clipboard->size - 1];
+    line->size = range.end_x;
+    line->data = NULL;
+    if (line->size > 0) {
+        line->data = malloc_s(line->size);
+        memcpy(line->data, last->data, line->size);
+    }
+
+    editorDeleteText(file, range);
+}
+
+static void pasteText(EditorFile* file,
+                      const EditorClipboard* clipboard,
+                      int x,
+                      int y,
+                      bool take) {
     if (!clipboard->size)
         return;
 
@@ -215,25 +261,41 @@ void editorPasteText(EditorFile* file,
 
         editorRowInsertString(file, row, x, paste, paste_len);
     } else {
+        EditorRow* row = &file->row[y];
+        int count = (int)clipboard->size - 1;
+
         // First line
-        size_t tail_len = file->row[y].size - x;
-        editorInsertRow(file, y + 1, &file->row[y].data[x], tail_len);
-        file->row[y].size = x;
-        editorRowAppendString(file, &file->row[y], clipboard->lines[0].data,
-                              clipboard->lines[0].size);
-        // Middle
-        for (size_t i = 1; i < clipboard->size - 1; i++) {
-            editorInsertRow(file, y + i, clipboard->lines[i].data,
-                            clipboard->lines[i].size);
+        size_t tail_len = row->size - x;
+        char* tail = NULL;
+        if (tail_len > 0) {
+            tail = malloc_s(tail_len);
+            memcpy(tail, &row->data[x], tail_len);
         }
-        // Last line
-        EditorRow* row = &file->row[y + clipboard->size - 1];
-        char* paste = clipboard->lines[clipboard->size - 1].data;
-        size_t paste_len = clipboard->lines[clipboard->size - 1].size;
-        editorRowInsertString(file, row, 0, paste, paste_len);
+        row->size = x;
+        editorRowAppendString(file, row, clipboard->lines[0].data,
+                              clipboard->lines[0].size);
+
+        // Middle and last line
+        editorInsertRows(file, y + 1, &clipboard->lines[1], count, take);
+        editorRowAppendString(file, &file->row[y + count], tail, tail_len);
+        free(tail);
     }
 }
 
+void editorPasteText(EditorFile* file,
+                     const EditorClipboard* clipboard,
+                     int x,
+                     int y) {
+    pasteText(file, clipboard, x, y, false);
+}
+
+void editorAttachText(EditorFile* file,
+                      EditorClipboard* clipboard,
+                      int x,
+                      int y) {
+    pasteText(file, clipboard, x, y, true);
+}
+
 void editorFreeClipboardContent(EditorClipboard* clipboard) {
     if (!clipboard || !clipboard->size)
         return;
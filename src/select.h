@@ -33,6 +33,16 @@ void editorPasteText(EditorFile* file,
                      const EditorClipboard* clipboard,
                      int x,
                      int y);
+// Same as copying and deleting or pasting the text, but the row buffers are
+// moved between the file and the clipboard. A clipboard given back to the file
+// keeps the line sizes, with NULL data for the moved lines.
+void editorDetachText(EditorFile* file,
+                      EditorClipboard* clipboard,
+                      EditorSelectRange range);
+void editorAttachText(EditorFile* file,
+                      EditorClipboard* clipboard,
+                      int x,
+                      int y);
 
 void editorFreeClipboardContent(EditorClipboard* clipboard);
 
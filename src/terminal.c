@@ -165,6 +165,92 @@ static bool readConsoleKey(uint32_t* out, int timeout_ms) {
     }
 }
 
+#define PASTE_END "\x1b[201~"
+#define PASTE_END_LEN (sizeof(PASTE_END) - 1)
+
+typedef VECTOR(Str) PasteLines;
+
+static void pasteAddLine(PasteLines* lines, const char* s, size_t len) {
+    Str line = {.data = NULL, .size = (int)len};
+    if (len) {
+        line.data = malloc_s(len);
+        memcpy(line.data, s, len);
+    }
+    vector_push(*lines, line);
+}
+
+// Reads the rest of a bracketed paste and splits it into lines.
+// CR, LF and CRLF all end a line.
+static bool editorReadPaste(EditorClipboard* clipboard, int timeout) {
+    abuf data = ABUF_INIT;
+    size_t search = 0;  // Where the end marker may start
+    bool found = false;
+    while (!found) {
+        const char* input;
+        size_t n = peekConsoleInput(&input, timeout);
+        if (n == 0) {
+            abufFree(&data);
+            return false;
+        }
+
+        size_t old_len = data.len;
+        abufAppendN(&data, input, n);
+
+        // Only the end marker has an ESC in a sane paste
+        const char* end = data.buf + data.len;
+        const char* p = data.buf + search;
+        while ((p = memchr(p, ESC, end - p)) != NULL) {
+            if ((size_t)(end - p) < PASTE_END_LEN)
+                break;
+            if (memcmp(p, PASTE_END, PASTE_END_LEN) == 0) {
+                found = true;
+                break;
+            }
+            p++;
+        }
+
+        if (found) {
+            // Input after the marker belongs to the next event
+            size_t paste_len = p - data.buf;
+            consumeConsoleInput(paste_len + PASTE_END_LEN - old_len);
+            data.len = paste_len;
+        } else {
+            consumeConsoleInput(n);
+            search = p ? (size_t)(p - data.buf) : data.len;
+        }
+    }
+
+    PasteLines content = {0};
+    if (data.len) {
+        const char* p = data.buf;
+        const char* end = data.buf + data.len;
+        if (!memchr(p, '\r', data.len)) {
+            const char* nl;
+            while ((nl = memchr(p, '\n', end - p)) != NULL) {
+                pasteAddLine(&content, p, nl - p);
+                p = nl + 1;
+            }
+        } else {
+            for (const char* c = p; c < end; c++) {
+                if (*c != '\r' && *c != '\n')
+                    continue;
+                pasteAddLine(&content, p, c - p);
+                if (*c == '\r' && c + 1 < end && c[1] == '\n')
+                    c++;
+                p = c + 1;
+            }
+        }
+        pasteAddLine(&content, p, end - p);
+        vector_shrink(content);
+    }
+    abufFree(&data);
+
+    // Transfer the vector to the clipboard
+    clipboard->size = content.size;
+    clipboard->lines = content.data;
+    return true;
+}
+
 // ANSII escape sequences parsing.
 EditorInput editorReadEvent(void) {
     uint32_t c;
@@ -176,7 +262,9 @@ EditorInput editorReadEvent(void) {
             ev.type = CONSOLE_EVENT_RESIZE;
             ev.data.resize = pending_resize;
         } else {
+            EditorPerfPhase phase = editorPerfEnter(PERF_IDLE);
             ev = readConsoleEvent(READ_WAIT_INFINITE);
+            editorPerfLeave(phase);
         }
 
         if (ev.type == CONSOLE_EVENT_KEY) {
@@ -212,7 +300,8 @@ EditorInput editorReadEvent(void) {
                 return result;
             }
             seq[i] = (char)c;
-            if (isUpper(seq[i]) || seq[i] == 'm' || seq[i] == '~') {
+            if (isUpper(seq[i]) || seq[i] == 'm' || seq[i] == '~' ||
+                seq[i] == 'y') {
                 success = true;
                 break;
             }
@@ -224,88 +313,18 @@ EditorInput editorReadEvent(void) {
 
         // Bracketed paste
         if (strcmp(seq, "[200~") == 0) {
-            VECTOR(Str) content = {0};
-            abuf line = ABUF_INIT;
-
-            bool last_was_cr = false;
-            while (true) {
-                if (!readConsoleKey(&c, timeout)) {
-                    vector_free(content);
-                    abufFree(&line);
-                    return result;
-                }
-
-                if (c == ESC) {
-                    uint32_t end_seq[5];
-                    bool is_end = true;
-                    const char expected[5] = {'[', '2', '0', '1', '~'};
-
-                    size_t index;
-                    for (index = 0;
-                         index < sizeof(end_seq) / sizeof(end_seq[0]);
-                         index++) {
-                        if (!readConsoleKey(&end_seq[index], timeout)) {
-                            vector_free(content);
-                            abufFree(&line);
-                            return result;
-                        }
-
-                        if (end_seq[index] != (uint32_t)expected[index]) {
-                            is_end = false;
-                            break;
-                        }
-                    }
-
-                    if (is_end) {
-                        EditorClipboard clipboard = {0};
-                        if (content.size || line.len) {
-                            Str s_line = {
-                                .data = line.buf,
-                                .size = line.len,
-                            };
-                            vector_push(content, s_line);
-                            vector_shrink(content);
-
-                            // transfer the vector to clipboard
-                            clipboard.size = content.size;
-                            clipboard.lines = content.data;
-                        }
-
-                        result.type = PASTE_INPUT;
-                        result.data.paste = clipboard;
-                        return result;
-                    }
-
-                    // paste the escape sequence so far in
-                    abufAppendN(&line, expected, index);
-                    // let the rest of the logic handle the last input
-                    c = end_seq[index];
-                }
+            if (editorReadPaste(&result.data.paste, timeout))
+                result.type = PASTE_INPUT;
+            return result;
+        }
 
-                if (c == '\r' || c == '\n') {
-                    if (c == '\n' && last_was_cr) {
-                        last_was_cr = false;
-                        continue;
-                    }
-
-                    last_was_cr = (c == '\r');
-
-                    Str s_line = {
-                        .data = line.buf,
-                        .size = line.len,
-                    };
-                    vector_push(content, s_line);
-                    memset(&line, 0, sizeof(abuf));
-                } else {
-                    last_was_cr = false;
-
-                    char utf8[4];
-                    int bytes = encodeUTF8(c, utf8);
-                    if (bytes == -1)
-                        continue;
-                    abufAppendN(&line, utf8, bytes);
-                }
-            }
+        // DECRPM: ESC [ ? Ps ; Pm $ y
+        int mode, value;
+        if (sscanf(seq, "[?%d;%d$y", &mode, &value) == 2) {
+            // 1 = set, 2 = reset, 0 = not recognized
+            if (mode == 2026)
+                gEditor.sync_output = (value == 1 || value == 2);
+            return result;
         }
 
         // Mouse input
@@ -430,6 +449,7 @@ static void SIGABRT_handler(int sig) {
 #define MOUSE_DISABLE "\x1b[?1007l\x1b[?1006l\x1b[?1002l\x1b[?1000l"
 #define BRACKETED_PASTE_ENABLE "\x1b[?2004h"
 #define BRACKETED_PASTE_DISABLE "\x1b[?2004l"
+#define SYNC_OUTPUT_QUERY "\x1b[?2026$p"
 
 void enableMouse(void) {
     writeConsoleStr(MOUSE_ENABLE);
@@ -484,7 +504,7 @@ static bool terminal_active = false;
 void terminalStart(void) {
     terminal_active = true;
     enableRawMode();
-    writeConsoleStr(SWAP_ENABLE BRACKETED_PASTE_ENABLE);
+    writeConsoleStr(SWAP_ENABLE BRACKETED_PASTE_ENABLE SYNC_OUTPUT_QUERY);
     if (gEditor.mouse_mode) {
         enableMouse();
     } else {
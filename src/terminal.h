@@ -17,6 +17,11 @@
 #define ANSI_CURSOR_RESET_POS "\x1b[H"
 #define ANSI_CURSOR_SHOW "\x1b[?25h"
 #define ANSI_CURSOR_HIDE "\x1b[?25l"
+#define ANSI_RESET_SCROLL_REGION "\x1b[r"
+
+// Synchronized output (DEC mode 2026)
+#define ANSI_SYNC_BEGIN "\x1b[?2026h"
+#define ANSI_SYNC_END "\x1b[?2026l"
 
 // Keys
 #define CTRL_KEY(k) ((k) & 0x1F)
@@ -17,10 +17,13 @@ void panic(const char* file, int line, const char* s) {
     exit(EXIT_FAILURE);
 }
 
+uint64_t alloc_count = 0;
+
 void* _malloc_s(const char* file, int line, size_t size) {
     if (size == 0)
         return NULL;
 
+    alloc_count++;
     void* ptr = malloc(size);
     if (!ptr)
         panic(file, line, "malloc");
@@ -32,6 +35,7 @@ void* _calloc_s(const char* file, int line, size_t n, size_t size) {
     if (n == 0 || size == 0)
         return NULL;
 
+    alloc_count++;
     void* ptr = calloc(n, size);
     if (!ptr)
         panic(file, line, "calloc");
@@ -45,6 +49,7 @@ void* _realloc_s(const char* file, int line, void* ptr, size_t size) {
         return NULL;
     }
 
+    alloc_count++;
     ptr = realloc(ptr, size);
     if (!ptr)
         panic(file, line, "realloc");
@@ -549,6 +554,43 @@ size_t base64Encode(const char* buf, size_t len, char* output) {
     return (size_t)(p - output);
 }
 
+static inline uint64_t hashFinalize(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline uint64_t hashBlock(uint64_t h, uint64_t v) {
+    h ^= v * 0x87C37B91114253D5ULL;
+    h = (h << 31) | (h >> 33);
+    return h * 0x4CF5AD432745937FULL;
+}
+
+uint64_t hashBytes(const void* data, size_t len, uint64_t seed) {
+    const uint8_t* p = (const uint8_t*)data;
+    uint64_t h = seed;
+    size_t remain = len;
+
+    while (remain >= 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        h = hashBlock(h, v);
+        p += 8;
+        remain -= 8;
+    }
+
+    if (remain) {
+        uint64_t v = 0;
+        memcpy(&v, p, remain);
+        h = hashBlock(h, v);
+    }
+
+    return hashFinalize(h ^ len);
+}
+
 bool writeConsoleAll(const void* buf, size_t len) {
     const uint8_t* p = (const uint8_t*)buf;
     while (len) {
@@ -170,6 +170,9 @@ static inline size_t base64EncodeLen(size_t len) {
 // Returns length including null terminator
 size_t base64Encode(const char* string, size_t len, char* output);
 
+// Hash
+uint64_t hashBytes(const void* data, size_t len, uint64_t seed);
+
 // Write console
 #define writeConsoleStr(s) writeConsole((s), sizeof(s) - 1)
 bool writeConsoleAll(const void* buf, size_t len);
@@ -0,0 +1,319 @@
+#include "wrap.h"
+
+#include "config.h"
+#include "editor.h"
+#include "output.h"
+#include "row.h"
+#include "unicode.h"
+
+void editorWrapIterInit(EditorWrapIter* it, const EditorRow* row, int width) {
+    it->row = row;
+    it->width = width;
+    it->cx = 0;
+    it->rx = 0;
+    it->line_start = 0;
+}
+
+// Move to the start of the next visual line, false at the end of the row.
+// A line breaks before the first character that doesn't fit; a character
+// wider than the line gets a line of its own.
+bool editorWrapIterNext(EditorWrapIter* it) {
+    const EditorRow* row = it->row;
+    while (it->cx < row->size) {
+        size_t byte_size;
+        uint32_t unicode =
+            decodeUTF8(&row->data[it->cx], row->size - it->cx, &byte_size);
+        if (byte_size == 0)
+            break;
+
+        int width;
+        if (unicode == '\t') {
+            int tab_size = tabsize.int_value;
+            width = tab_size - (it->rx % tab_size);
+        } else {
+            width = unicodeWidth(unicode);
+            if (width < 0)
+                width = 1;
+        }
+
+        if (width > 0 && it->rx > it->line_start &&
+            it->rx + width > it->line_start + it->width) {
+            it->line_start = it->rx;
+            return true;
+        }
+
+        it->rx += width;
+        it->cx += byte_size;
+    }
+    return false;
+}
+
+int editorRowWrapCount(const EditorRow* row, int width) {
+    if (row->rsize <= width)
+        return 1;
+
+    EditorWrapIter it;
+    editorWrapIterInit(&it, row, width);
+    int count = 1;
+    while (editorWrapIterNext(&it)) {
+        count++;
+    }
+    return count;
+}
+
+// Returns the rx where a visual line starts
+int editorRowWrapStart(const EditorRow* row, int width, int line) {
+    EditorWrapIter it;
+    editorWrapIterInit(&it, row, width);
+    while (line > 0 && editorWrapIterNext(&it)) {
+        line--;
+    }
+    return it.line_start;
+}
+
+// Returns the visual line that contains rx
+int editorRowWrapLine(const EditorRow* row, int width, int rx) {
+    if (row->rsize <= width)
+        return 0;
+
+    EditorWrapIter it;
+    editorWrapIterInit(&it, row, width);
+    int line = 0;
+    while (editorWrapIterNext(&it) && it.line_start <= rx) {
+        line++;
+    }
+    return line;
+}
+
+static void wrapEnsureCapacity(EditorWrapLayout* layout, int size) {
+    if (layout->capacity >= size)
+        return;
+
+    int capacity = layout->capacity ? layout->capacity : 16;
+    while (capacity < size) {
+        capacity += capacity / 2;
+    }
+    layout->counts = realloc_s(layout->counts, sizeof(int) * capacity);
+    layout->tree = realloc_s(layout->tree, sizeof(int) * (capacity + 1));
+    layout->capacity = capacity;
+}
+
+// Rebuild the nodes past tree_valid, each one is its count plus its children
+static void wrapBuildTree(EditorWrapLayout* layout) {
+    int* tree = layout->tree;
+    tree[0] = 0;
+    for (int i = layout->tree_valid + 1; i <= layout->num_rows; i++) {
+        int sum = layout->counts[i - 1];
+        for (int step = 1; step < (i & -i); step *= 2) {
+            sum += tree[i - step];
+        }
+        tree[i] = sum;
+    }
+    layout->tree_valid = layout->num_rows;
+}
+
+// Layouts of another tab size can't be kept in sync, so they are dropped
+static bool wrapLayoutInUse(EditorWrapLayout* layout) {
+    if (layout->width && layout->tab_size != tabsize.int_value) {
+        layout->width = 0;
+        layout->last_used = 0;
+    }
+    return layout->width != 0;
+}
+
+static void wrapBuildLayout(EditorWrapLayout* layout,
+                            const EditorFile* file,
+                            int width) {
+    wrapEnsureCapacity(layout, file->num_rows);
+    layout->width = width;
+    layout->tab_size = tabsize.int_value;
+    layout->num_rows = file->num_rows;
+    for (int i = 0; i < file->num_rows; i++) {
+        layout->counts[i] = editorRowWrapCount(&file->row[i], width);
+    }
+    layout->tree_valid = 0;
+    wrapBuildTree(layout);
+}
+
+static EditorWrapLayout* editorGetWrapLayout(EditorFile* file, int width) {
+    static uint32_t use_clock = 0;
+
+    EditorWrapLayout* layout = NULL;
+    for (int i = 0; i < WRAP_LAYOUT_MAX; i++) {
+        if (file->wrap[i].width == width &&
+            file->wrap[i].tab_size == tabsize.int_value) {
+            layout = &file->wrap[i];
+            break;
+        }
+    }
+
+    if (!layout) {
+        // Take an unused or the least recently used one
+        layout = &file->wrap[0];
+        for (int i = 1; i < WRAP_LAYOUT_MAX; i++) {
+            if (file->wrap[i].last_used < layout->last_used)
+                layout = &file->wrap[i];
+        }
+        wrapBuildLayout(layout, file, width);
+    }
+
+    layout->last_used = ++use_clock;
+    return layout;
+}
+
+EditorWrapLayout* editorGetSplitWrap(int split_index) {
+    if (!wrap.int_value)
+        return NULL;
+
+    EditorTab* tab = editorSplitGetTab(split_index);
+    EditorFile* file = editorTabGetFile(tab);
+
+    int start, end;
+    editorGetSplitScreenCols(split_index, &start, &end);
+    int width = (end - start) - editorGetLinenoWidth(file);
+    if (width <= 0)
+        return NULL;
+
+    return editorGetWrapLayout(file, width);
+}
+
+int editorWrapLineOfRow(EditorWrapLayout* layout, int row) {
+    if (layout->tree_valid < layout->num_rows)
+        wrapBuildTree(layout);
+
+    if (row > layout->num_rows)
+        row = layout->num_rows;
+
+    int line = 0;
+    for (int i = row; i > 0; i -= i & -i) {
+        line += layout->tree[i];
+    }
+    return line;
+}
+
+int editorWrapTotalLines(EditorWrapLayout* layout) {
+    return editorWrapLineOfRow(layout, layout->num_rows);
+}
+
+// Returns the row a visual line belongs to and the line index inside the row.
+// Lines past the end map to the last line.
+int editorWrapRowOfLine(EditorWrapLayout* layout, int line, int* sub) {
+    if (layout->tree_valid < layout->num_rows)
+        wrapBuildTree(layout);
+
+    int n = layout->num_rows;
+    if (n == 0) {
+        if (sub)
+            *sub = 0;
+        return 0;
+    }
+
+    if (line < 0)
+        line = 0;
+
+    int step = 1;
+    while (step * 2 <= n) {
+        step *= 2;
+    }
+
+    int row = 0;
+    for (; step > 0; step /= 2) {
+        if (row + step <= n && layout->tree[row + step] <= line) {
+            row += step;
+            line -= layout->tree[row];
+        }
+    }
+
+    if (row >= n) {
+        row = n - 1;
+        line = layout->counts[row] - 1;
+    }
+
+    if (sub)
+        *sub = line;
+    return row;
+}
+
+int editorWrapGetTop(EditorWrapLayout* layout, const EditorTab* tab) {
+    int row = tab->row_offset;
+    if (row >= layout->num_rows)
+        row = layout->num_rows - 1;
+    if (row < 0)
+        return 0;
+
+    int sub = tab->wrap_offset;
+    if (sub >= layout->counts[row])
+        sub = layout->counts[row] - 1;
+    if (sub < 0)
+        sub = 0;
+
+    return editorWrapLineOfRow(layout, row) + sub;
+}
+
+void editorWrapSetTop(EditorWrapLayout* layout, EditorTab* tab, int line) {
+    int total = editorWrapTotalLines(layout);
+    if (line >= total)
+        line = total - 1;
+    if (line < 0)
+        line = 0;
+    tab->row_offset = editorWrapRowOfLine(layout, line, &tab->wrap_offset);
+}
+
+void editorWrapUpdateRow(EditorFile* file, int row) {
+    for (int i = 0; i < WRAP_LAYOUT_MAX; i++) {
+        EditorWrapLayout* layout = &file->wrap[i];
+        if (!wrapLayoutInUse(layout) || row >= layout->num_rows)
+            continue;
+
+        int count = editorRowWrapCount(&file->row[row], layout->width);
+        int delta = count - layout->counts[row];
+        if (delta == 0)
+            continue;
+
+        layout->counts[row] = count;
+        for (int j = row + 1; j <= layout->tree_valid; j += j & -j) {
+            layout->tree[j] += delta;
+        }
+    }
+}
+
+void editorWrapInsertRows(EditorFile* file, int at, int count) {
+    for (int i = 0; i < WRAP_LAYOUT_MAX; i++) {
+        EditorWrapLayout* layout = &file->wrap[i];
+        if (!wrapLayoutInUse(layout))
+            continue;
+
+        wrapEnsureCapacity(layout, layout->num_rows + count);
+        memmove(&layout->counts[at + count], &layout->counts[at],
+                sizeof(int) * (layout->num_rows - at));
+        // Set when the rows are updated
+        for (int j = at; j < at + count; j++) {
+            layout->counts[j] = 1;
+        }
+        layout->num_rows += count;
+        if (layout->tree_valid > at)
+            layout->tree_valid = at;
+    }
+}
+
+void editorWrapDeleteRows(EditorFile* file, int at, int count) {
+    for (int i = 0; i < WRAP_LAYOUT_MAX; i++) {
+        EditorWrapLayout* layout = &file->wrap[i];
+        if (!wrapLayoutInUse(layout))
+            continue;
+
+        memmove(&layout->counts[at], &layout->counts[at + count],
+                sizeof(int) * (layout->num_rows - at - count));
+        layout->num_rows -= count;
+        if (layout->tree_valid > at)
+            layout->tree_valid = at;
+    }
+}
+
+void editorFreeWrapLayouts(EditorFile* file) {
+    for (int i = 0; i < WRAP_LAYOUT_MAX; i++) {
+        free(file->wrap[i].counts);
+        free(file->wrap[i].tree);
+    }
+    memset(file->wrap, 0, sizeof(file->wrap));
+}
@@ -0,0 +1,59 @@
+#ifndef WRAP_H
+#define WRAP_H
+
+#include "utils.h"
+
+typedef struct EditorFile EditorFile;
+typedef struct EditorRow EditorRow;
+typedef struct EditorTab EditorTab;
+
+// Widths a file can be wrapped at, at most one per split
+#define WRAP_LAYOUT_MAX 4
+
+// Visual line counts of a file wrapped at one width. A Fenwick tree over the
+// counts maps between rows and visual lines in O(log n).
+typedef struct EditorWrapLayout {
+    int width;  // 0 if unused
+    int tab_size;
+    int num_rows;
+    int capacity;
+    int* counts;
+    int* tree;       // 1-based
+    int tree_valid;  // Nodes past this are rebuilt on the next query
+    uint32_t last_used;
+} EditorWrapLayout;
+
+// Walks a row one visual line at a time
+typedef struct EditorWrapIter {
+    const EditorRow* row;
+    int width;
+    int cx;
+    int rx;
+    int line_start;  // rx
+} EditorWrapIter;
+
+void editorWrapIterInit(EditorWrapIter* it, const EditorRow* row, int width);
+bool editorWrapIterNext(EditorWrapIter* it);
+
+int editorRowWrapCount(const EditorRow* row, int width);
+int editorRowWrapStart(const EditorRow* row, int width, int line);
+int editorRowWrapLine(const EditorRow* row, int width, int rx);
+
+// NULL if wrapping is off
+EditorWrapLayout* editorGetSplitWrap(int split_index);
+
+int editorWrapTotalLines(EditorWrapLayout* layout);
+int editorWrapLineOfRow(EditorWrapLayout* layout, int row);
+int editorWrapRowOfLine(EditorWrapLayout* layout, int line, int* sub);
+
+// First visual line shown in a tab
+int editorWrapGetTop(EditorWrapLayout* layout, const EditorTab* tab);
+void editorWrapSetTop(EditorWrapLayout* layout, EditorTab* tab, int line);
+
+// Keep the layouts of a file in sync with its rows
+void editorWrapUpdateRow(EditorFile* file, int row);
+void editorWrapInsertRows(EditorFile* file, int at, int count);
+void editorWrapDeleteRows(EditorFile* file, int at, int count);
+void editorFreeWrapLayouts(EditorFile* file);
+
+#endif
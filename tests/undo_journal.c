@@ -0,0 +1,156 @@
+#include "config.h"
+#include "editor.h"
+#include "file_io.h"
+#include "headless.h"
+#include "input.h"
+#include "os.h"
+#include "terminal.h"
+
+// Undo journal across sessions on the headless console. Each session opens
+// the test file, replays keys and closes the editor without saving.
+
+#define TEST_HOME "undo_journal_home"
+#define TEST_FILE "undo_journal_test.txt"
+
+#define KEY_SAVE "\x13"
+#define KEY_UNDO "\x1a"
+#define KEY_REDO "\x19"
+
+static int failures = 0;
+
+#define CHECK_ROW(expected)                                                 \
+    do {                                                                    \
+        if (!rowEquals(expected)) {                                         \
+            fprintf(stderr, "%s:%d: expected \"%s\"\n", __FILE__, __LINE__, \
+                    expected);                                              \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+static bool rowEquals(const char* expected) {
+    const EditorFile* file = editorGetActiveFile();
+    size_t len = strlen(expected);
+    return file->num_rows > 0 && (size_t)file->row[0].size == len &&
+           memcmp(file->row[0].data, expected, len) == 0;
+}
+
+// Remove the files under path, the directories are kept
+static void removeFiles(const char* path) {
+    DirIter iter = dirFindFirst(path);
+    if (iter.error)
+        return;
+
+    do {
+        const char* name = dirGetName(&iter);
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            continue;
+
+        char child[EDITOR_PATH_MAX];
+        snprintf(child, sizeof(child), PATH_CAT("%s", "%s"), path, name);
+        if (getFileType(child) == FT_DIR) {
+            removeFiles(child);
+        } else {
+            remove(child);
+        }
+    } while (dirNext(&iter));
+    dirClose(&iter);
+}
+
+static bool writeTestFile(const char* content) {
+    FILE* fp = openFile(TEST_FILE, "wb");
+    if (!fp)
+        return false;
+    fputs(content, fp);
+    fclose(fp);
+    return true;
+}
+
+static bool openSession(void) {
+    editorInit();
+    gEditor.state = STATE_EDIT;
+    editorCmd("undo_journal 1");
+
+    headlessSetWindowSize(24, 80);
+    terminalStart();
+
+    EditorFile file;
+    if (editorLoadFile(&file, TEST_FILE, false) != OPEN_FILE ||
+        editorAddFileToActiveSplit(&file) == -1) {
+        terminalExit();
+        editorFree();
+        return false;
+    }
+    return true;
+}
+
+static void closeSession(void) {
+    terminalExit();
+    editorFree();
+}
+
+static void pressKeys(const char* keys) {
+    headlessPushStr(keys);
+    while (!headlessInputEmpty()) {
+        editorProcessInput(getTimeMs());
+    }
+}
+
+int main(void) {
+    removeFiles(TEST_HOME);
+    makeDir(TEST_HOME);
+#ifdef _WIN32
+    _putenv_s(ENV_HOME, TEST_HOME);
+#else
+    setenv(ENV_HOME, TEST_HOME, 1);
+#endif
+
+    if (!writeTestFile("abc\n")) {
+        fprintf(stderr, "Failed to write %s\n", TEST_FILE);
+        return 1;
+    }
+
+    // Save, undo past the saved state and type over its record. The new
+    // record has the same size, so the old saved offset still ends a record.
+    if (!openSession())
+        goto FAIL;
+    pressKeys("1");
+    pressKeys(KEY_SAVE);
+    pressKeys(KEY_UNDO);
+    CHECK_ROW("abc");
+    pressKeys("x");
+    CHECK_ROW("xabc");
+    closeSession();
+
+    // The saved state is gone, so the history must not be restored
+    if (!openSession())
+        goto FAIL;
+    CHECK_ROW("1abc");
+    pressKeys(KEY_UNDO);
+    CHECK_ROW("1abc");
+    pressKeys(KEY_REDO);
+    CHECK_ROW("1abc");
+    pressKeys("Q");
+    pressKeys(KEY_SAVE);
+    pressKeys("R");
+    closeSession();
+
+    // The new journal still keeps the unsaved edit and the saved one
+    if (!openSession())
+        goto FAIL;
+    CHECK_ROW("Q1abc");
+    pressKeys(KEY_REDO);
+    CHECK_ROW("QR1abc");
+    pressKeys(KEY_UNDO);
+    pressKeys(KEY_UNDO);
+    CHECK_ROW("1abc");
+    closeSession();
+
+    headlessFree();
+    remove(TEST_FILE);
+    removeFiles(TEST_HOME);
+    return failures ? 1 : 0;
+
+FAIL:
+    fprintf(stderr, "Failed to open %s\n", TEST_FILE);
+    return 1;
+}